@@ -0,0 +1,223 @@
+/*
+ *  Copyright (C) 2014 Cole Minor
+ *  This file is part of elm-draw-tiles.
+ *
+ *  elm-draw-tiles is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  elm-draw-tiles is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "image.h"
+
+#include <zlib.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+
+/* bytes of compressed data per IDAT chunk */
+#define CHUNK_SIZE 65536
+
+struct image {
+  FILE *f;
+  const char *path;
+  int width, height, depth;
+  int rows;
+  z_stream z;
+  /* a filter byte and the packed pixels of a row */
+  uint8_t *line;
+  size_t line_size;
+  /* the first failure, after which nothing more is written */
+  int failed;
+  /* only a regular file is removed when it fails */
+  int regular;
+  char error[256];
+  uint8_t out[CHUNK_SIZE];
+};
+
+static void put_uint32(uint8_t *b, uint32_t v) {
+  b[0] = v >> 24;
+  b[1] = v >> 16;
+  b[2] = v >> 8;
+  b[3] = v;
+}
+
+static void write_bytes(image_t *i, const void *b, size_t n) {
+  if (i->failed)
+    return;
+  if (fwrite(b, 1, n, i->f) != n) {
+    snprintf(i->error, sizeof i->error, "failed to write '%s': %s",
+             i->path, strerror(errno));
+    i->failed = 1;
+  }
+}
+
+static void write_chunk(image_t *i, const char *type, const uint8_t *d,
+                        size_t n) {
+  uint8_t b[4];
+  uLong c;
+
+  put_uint32(b, n);
+  write_bytes(i, b, 4);
+  write_bytes(i, type, 4);
+  write_bytes(i, d, n);
+  c = crc32(0, (const Bytef *) type, 4);
+  if (n)
+    c = crc32(c, d, n);
+  put_uint32(b, c);
+  write_bytes(i, b, 4);
+}
+
+/* Compresses what is left of the input, writing out each chunk's
+ * worth of data as it fills. */
+static void deflate_line(image_t *i, int flush) {
+  z_stream *z = &i->z;
+  int e;
+
+  do {
+    e = deflate(z, flush);
+    if (e == Z_STREAM_ERROR) {
+      snprintf(i->error, sizeof i->error, "deflate failed");
+      i->failed = 1;
+      return;
+    }
+    if (!z->avail_out || (flush == Z_FINISH && z->avail_out < CHUNK_SIZE)) {
+      write_chunk(i, "IDAT", i->out, CHUNK_SIZE - z->avail_out);
+      z->next_out = i->out;
+      z->avail_out = CHUNK_SIZE;
+    }
+  } while (!i->failed
+           && (z->avail_in || (flush == Z_FINISH && e != Z_STREAM_END)));
+}
+
+image_t *image_create(const char *path, int width, int height,
+                      int depth, char *error, size_t error_size) {
+  static const uint8_t signature[8] = {
+    0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n'
+  };
+  struct stat st;
+  uint8_t h[13];
+  image_t *i;
+
+  if (!(i = calloc(1, sizeof *i))) {
+    snprintf(error, error_size, "out of memory");
+    return NULL;
+  }
+  i->path = path;
+  i->width = width;
+  i->height = height;
+  i->depth = depth;
+  i->line_size = 1 + ((size_t) width * depth + 7) / 8;
+  if (!(i->line = malloc(i->line_size))) {
+    snprintf(error, error_size, "out of memory");
+    free(i);
+    return NULL;
+  }
+  if (deflateInit(&i->z, Z_DEFAULT_COMPRESSION) != Z_OK) {
+    snprintf(error, error_size, "deflateInit failed");
+    free(i->line);
+    free(i);
+    return NULL;
+  }
+  i->z.next_out = i->out;
+  i->z.avail_out = CHUNK_SIZE;
+  if (!(i->f = fopen(path, "wb"))) {
+    snprintf(error, error_size, "failed to open '%s' for writing: %s",
+             path, strerror(errno));
+    deflateEnd(&i->z);
+    free(i->line);
+    free(i);
+    return NULL;
+  }
+
+  i->regular = !fstat(fileno(i->f), &st) && S_ISREG(st.st_mode);
+
+  write_bytes(i, signature, sizeof signature);
+  put_uint32(h, width);
+  put_uint32(h + 4, height);
+  h[8] = depth;
+  h[9] = 0;   /* grayscale */
+  h[10] = 0;  /* deflate */
+  h[11] = 0;  /* adaptive filtering */
+  h[12] = 0;  /* not interlaced */
+  write_chunk(i, "IHDR", h, sizeof h);
+  if (i->failed) {
+    snprintf(error, error_size, "%s", i->error);
+    image_discard(i);
+    return NULL;
+  }
+  return i;
+}
+
+int image_write_row(image_t *i, const uint8_t *row) {
+  uint8_t *p = i->line + 1;
+  int x;
+
+  if (i->failed)
+    return -1;
+  i->line[0] = 0;  /* no filter */
+  if (i->depth == 8) {
+    memcpy(p, row, i->width);
+  } else {
+    memset(p, 0, i->line_size - 1);
+    for (x = 0; x < i->width; x++) {
+      if (row[x] > IMAGE_WHITE_THRESHOLD)
+        p[x >> 3] |= 0x80 >> (x & 7);
+    }
+  }
+  i->z.next_in = i->line;
+  i->z.avail_in = i->line_size;
+  deflate_line(i, Z_NO_FLUSH);
+  i->rows++;
+  return i->failed ? -1 : 0;
+}
+
+static void free_image(image_t *i) {
+  deflateEnd(&i->z);
+  free(i->line);
+  free(i);
+}
+
+int image_close(image_t *i, char *error, size_t error_size) {
+  if (!i->failed && i->rows != i->height) {
+    snprintf(i->error, sizeof i->error, "image '%s' has %d rows, not %d",
+             i->path, i->rows, i->height);
+    i->failed = 1;
+  }
+  if (!i->failed) {
+    deflate_line(i, Z_FINISH);
+    write_chunk(i, "IEND", 0, 0);
+  }
+  if (fclose(i->f) && !i->failed) {
+    snprintf(i->error, sizeof i->error, "failed to write '%s': %s",
+             i->path, strerror(errno));
+    i->failed = 1;
+  }
+  if (i->failed) {
+    snprintf(error, error_size, "%s", i->error);
+    if (i->regular)
+      remove(i->path);
+    free_image(i);
+    return -1;
+  }
+  free_image(i);
+  return 0;
+}
+
+void image_discard(image_t *i) {
+  fclose(i->f);
+  if (i->regular)
+    remove(i->path);
+  free_image(i);
+}
@@ -0,0 +1,50 @@
+/*
+ *  Copyright (C) 2014 Cole Minor
+ *  This file is part of elm-draw-tiles.
+ *
+ *  elm-draw-tiles is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  elm-draw-tiles is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef ELM_DRAW_TILES_IMAGE_H
+#define ELM_DRAW_TILES_IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* A grayscale PNG image written a row at a time, so no more than a
+ * row of it is ever held. */
+typedef struct image image_t;
+
+/* Starts an image of 1 or 8 bits per pixel, or returns null with a
+ * message in error. */
+image_t *image_create(const char *path, int width, int height,
+                      int depth, char *error, size_t error_size);
+
+/* Gray levels above this are white at 1 bit per pixel, the same
+ * level mask2rects takes as foreground. */
+#define IMAGE_WHITE_THRESHOLD 125
+
+/* Adds the next row, one byte per pixel. Returns nonzero once
+ * writing the image has failed; image_close then tells why. */
+int image_write_row(image_t *i, const uint8_t *row);
+
+/* Finishes and closes the image once every row has been added.
+ * Returns nonzero with a message in error if it could not be
+ * written, and the partial file is removed. */
+int image_close(image_t *i, char *error, size_t error_size);
+
+/* Closes and removes an image that will not be finished. */
+void image_discard(image_t *i);
+
+#endif /* ELM_DRAW_TILES_IMAGE_H */
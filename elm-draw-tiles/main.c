@@ -16,86 +16,232 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *
  */
+#include "image.h"
 #include "map.h"
 #include "options.h"
+#include "raster.h"
 #include "utility.h"
 
-#include <cairo.h>
-
+#include <errno.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* the output file of each layer of each map */
+static char **outputs;
+static char **maps;
+static int map_count;
+static int next_map;
+static int failed;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void layer_name(const layer_t *l, char *b, size_t n) {
+  switch (l->type) {
+  case LAYER_WALKABLE:
+    snprintf(b, n, "walkable");
+    break;
+  case LAYER_HEIGHT:
+    snprintf(b, n, "height");
+    break;
+  case LAYER_VALUE:
+    snprintf(b, n, "%d", l->value);
+    break;
+  }
+}
+
+static void layer_levels(const layer_t *l, uint8_t *levels) {
+  int i;
+  for (i = 0; i < 256; i++) {
+    switch (l->type) {
+    case LAYER_WALKABLE:
+      levels[i] = i ? 255 : 0;
+      break;
+    case LAYER_HEIGHT:
+      levels[i] = i;
+      break;
+    case LAYER_VALUE:
+      levels[i] = i == l->value ? 255 : 0;
+      break;
+    }
+  }
+}
 
-static cairo_surface_t *create_surface(void) {
-  cairo_surface_t *s;
-  cairo_format_t f;
-  int w, h;
+/* the map file name without its directory and extensions */
+static void map_name(const char *p, char *b, size_t n) {
+  const char *s = strrchr(p, '/');
+  size_t l;
 
-  f = CAIRO_FORMAT_ARGB32;
-  w = options.image_width;
-  h = options.image_height;
-  s = cairo_image_surface_create(f, w, h);
-  return s;
+  snprintf(b, n, "%s", s ? s + 1 : p);
+  l = strlen(b);
+  if (l > 3 && !strcmp(b + l - 3, ".gz"))
+    b[l -= 3] = 0;
+  if (l > 4 && !strcmp(b + l - 4, ".elm"))
+    b[l - 4] = 0;
 }
 
-static void render_heightmap(const char *p) {
-  cairo_surface_t *s;
-  cairo_t *c;
-  const char *o;
+static char *output_name(const char *map, const layer_t *l) {
+  const char *p = options.output;
+  char m[256], n[16], *b;
+  size_t s = 1, i = 0;
+
+  map_name(map, m, sizeof m);
+  layer_name(l, n, sizeof n);
+  for (; *p; p++)
+    s += p[0] == '%' ? strlen(m) + strlen(n) : 1;
+  if (!(b = malloc(s)))
+    die("out of memory");
+  for (p = options.output; *p; p++) {
+    if (p[0] == '%' && p[1] == 'm') {
+      strcpy(b + i, m);
+      i += strlen(m);
+      p++;
+    } else if (p[0] == '%' && p[1] == 'l') {
+      strcpy(b + i, n);
+      i += strlen(n);
+      p++;
+    } else if (p[0] == '%' && p[1] == '%') {
+      b[i++] = '%';
+      p++;
+    } else {
+      b[i++] = *p;
+    }
+  }
+  b[i] = 0;
+  return b;
+}
+
+/* Draws every layer of a map in a single pass over its rows. A map
+ * that cannot be read is reported and left out, and no images are
+ * started for it. */
+/* An image that cannot be written is reported, and the map's other
+ * unfinished images are removed with it. */
+static int render_heightmap(const char *p, char **o) {
+  raster_t *r[MAX_LAYERS];
+  image_t *i[MAX_LAYERS];
+  uint8_t levels[MAX_LAYERS][256];
+  const layer_t *l;
+  uint8_t *row;
   map_t *m;
-  int x, y, mw, mh, *pw, *ph;
-  uint8_t t;
-  double u, v, tw, th;
-
-  m = map_new(p);
-  mw = m->width;
-  mh = m->height;
-  pw = &options.image_width;
-  ph = &options.image_height;
-  if (!*pw)
-    *pw = mw;
-  if (!*ph)
-    *ph = mh;
-  tw = (double) *pw / mw;
-  th = (double) *ph / mh;
-
-  s = create_surface();
-  c = cairo_create(s);
-  cairo_set_source_rgb(c, 0, 0, 0);
-  cairo_paint(c);
-  cairo_set_source_rgb(c, 1, 1, 1);
-  for (y = 0; y < mh; y++) {
-    for (x = 0; x < mw; x++) {
-      t = m->tiles[mw * y + x];
-      if (!t)
-        continue;
-      u = tw * x;
-      v = th * (mh - y - 1);
-      cairo_rectangle(c, u, v, tw, th);
-      cairo_fill(c);
+  int y, k, w, h, d[MAX_LAYERS];
+  int n = options.layer_count, bad = -1, failed = 0;
+  char e[512];
+
+  if (!(m = map_new(p, e, sizeof e))) {
+    fprintf(stderr, EXECUTABLE_NAME ": %s: %s\n", p, e);
+    return -1;
+  }
+  w = options.image_width ? options.image_width : m->width;
+  h = options.image_height ? options.image_height : m->height;
+
+  for (k = 0; k < n; k++) {
+    l = &options.layers[k];
+    d[k] = options.depth;
+    if (!d[k])
+      d[k] = l->type != LAYER_HEIGHT && raster_exact(m, w, h) ? 1 : 8;
+    layer_levels(l, levels[k]);
+    r[k] = raster_new(m, w, h, levels[k]);
+    if (!(i[k] = image_create(o[k], w, h, d[k], e, sizeof e))) {
+      fprintf(stderr, EXECUTABLE_NAME ": %s: %s\n", p, e);
+      raster_free(r[k]);
+      while (k-- > 0) {
+        image_discard(i[k]);
+        raster_free(r[k]);
+      }
+      map_free(m);
+      return -1;
     }
   }
-  cairo_destroy(c);
+  if (!(row = malloc(w)))
+    die("out of memory");
+  for (y = 0; bad < 0 && y < h; y++) {
+    for (k = 0; bad < 0 && k < n; k++) {
+      raster_row(r[k], y, row);
+      if (image_write_row(i[k], row))
+        bad = k;
+    }
+  }
+  free(row);
 
-  o = options.output;
-  cairo_surface_write_to_png(s, o);
-  cairo_surface_destroy(s);
-  printf("wrote %dx%d PNG image '%s'\n",
-         *pw, *ph, o);
+  for (k = 0; k < n; k++) {
+    if (bad >= 0 && k != bad) {
+      image_discard(i[k]);
+    } else if (image_close(i[k], e, sizeof e)) {
+      fprintf(stderr, EXECUTABLE_NAME ": %s: %s\n", p, e);
+      failed = 1;
+    } else {
+      printf("wrote %dx%d %d-bit PNG image '%s'\n",
+             w, h, d[k], o[k]);
+    }
+    raster_free(r[k]);
+  }
 
   map_free(m);
+  return failed ? -1 : 0;
 }
 
-int main(int argc, char **argv) {
+static void *render_maps(void *a) {
   int i;
+  (void) a;
+  for (;;) {
+    pthread_mutex_lock(&lock);
+    i = next_map++;
+    pthread_mutex_unlock(&lock);
+    if (i >= map_count)
+      break;
+    if (render_heightmap(maps[i], &outputs[i * options.layer_count])) {
+      pthread_mutex_lock(&lock);
+      failed = 1;
+      pthread_mutex_unlock(&lock);
+    }
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  pthread_t *t;
+  int i, j, n, threads;
 
   if (argc < 2)
     options_usage();
   i = options_parse(argc, argv);
   if (i >= argc)
-    die("missing note file argument");
-  if (argc - i > 1)
-    die("too many arguments");
-  options_validate();
+    die("missing map file argument");
+  maps = argv + i;
+  map_count = argc - i;
+  options_validate(map_count);
 
-  render_heightmap(argv[i]);
-  return 0;
+  n = map_count * options.layer_count;
+  if (!(outputs = malloc(n * sizeof *outputs)))
+    die("out of memory");
+  for (i = 0; i < n; i++)
+    outputs[i] = output_name(maps[i / options.layer_count],
+                             &options.layers[i % options.layer_count]);
+  for (i = 0; i < n; i++) {
+    for (j = i + 1; j < n; j++) {
+      if (!strcmp(outputs[i], outputs[j]))
+        die("more than one image would be written to '%s'", outputs[i]);
+    }
+  }
+
+  threads = options.threads;
+  if (!threads && (threads = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+    threads = 1;
+  if (threads > map_count)
+    threads = map_count;
+  if (!(t = malloc(threads * sizeof *t)))
+    die("out of memory");
+  for (i = 0; i < threads; i++) {
+    if ((errno = pthread_create(&t[i], 0, render_maps, 0)))
+      die("pthread_create failed: %s", strerror(errno));
+  }
+  for (i = 0; i < threads; i++)
+    pthread_join(t[i], 0);
+
+  for (i = 0; i < n; i++)
+    free(outputs[i]);
+  free(outputs);
+  free(t);
+  return failed;
 }
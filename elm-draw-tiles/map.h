@@ -19,15 +19,21 @@
 #ifndef ELM_DRAW_TILES_MAP_H
 #define ELM_DRAW_TILES_MAP_H
 
+#include "elm.h"
+
+#include <stddef.h>
 #include <stdint.h>
 
 typedef struct {
   int width;
   int height;
-  uint8_t *tiles;
+  const uint8_t *tiles;
+  elm_t *elm;
 } map_t;
 
-map_t *map_new(const char *p);
+/* Opens a map, or returns null and writes a message to the error
+ * buffer. */
+map_t *map_new(const char *p, char *error, size_t error_size);
 void map_free(map_t *m);
 
 #endif /* ELM_DRAW_TILES_MAP_H */
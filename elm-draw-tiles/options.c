@@ -26,25 +26,48 @@
 #include <string.h>
 
 #define DEFAULT_OUTPUT "hmout.png"
+#define DEFAULT_PATTERN "%m-%l.png"
 
 options_t options;
 
 void options_usage(void) {
   const char *u =
-    "Usage: " EXECUTABLE_NAME " [options] MAP\n"
+    "Usage: " EXECUTABLE_NAME " [options] MAP...\n"
     "\n"
     "Options:\n"
-    "  -o FILENAME      output image file name\n"
+    "  -d DEPTH         bits per pixel, 1 or 8\n"
+    "  -j THREADS       number of maps drawn at once\n"
+    "  -l LAYER,...     layers to draw, default walkable\n"
+    "  -o PATTERN       output image file name\n"
     "  -s WIDTH,HEIGHT  image dimensions in pixels\n"
     "\n"
     "MAP is a ELM file, optionally gzip compressed.\n"
     "\n"
+    "A LAYER is one of:\n"
+    "  walkable  white where tiles are walkable\n"
+    "  height    tile values as gray levels\n"
+    "  N         white where tiles have the value N\n"
+    "\n"
     "If the -s option is omitted, the image will have\n"
     "dimensions equal to size in tiles of the map.\n"
     "\n"
-    "If the -o option is omitted, the image is\n"
-    "written to '" DEFAULT_OUTPUT "' in the current\n"
-    "directory.\n"
+    "In PATTERN, %m stands for the map name, %l for\n"
+    "the layer name and %% for a percent sign. If the\n"
+    "-o option is omitted, the image of a single map\n"
+    "and layer is written to '" DEFAULT_OUTPUT "', and\n"
+    "otherwise each image is written to\n"
+    "'" DEFAULT_PATTERN "', all in the current directory.\n"
+    "\n"
+    "The image is a grayscale PNG. If the -d option\n"
+    "is omitted, it has 1 bit per pixel when every\n"
+    "tile is a whole number of pixels, or 8 bits so\n"
+    "that partly covered pixels are shaded. Height\n"
+    "layers are always 8 bits unless -d is given.\n"
+    "\n"
+    "Maps that cannot be read are reported and\n"
+    "skipped, and so are images that cannot be\n"
+    "written, leaving no partial file behind. The\n"
+    "exit status is then 1.\n"
     "\n";
   printf("%s", u);
   exit(1);
@@ -55,12 +78,54 @@ static void parse_xy(const char *s, int *x, int *y) {
     die("invalid dimension argument: %s", s);
 }
 
+static void parse_layers(const char *s) {
+  options_t *o = &options;
+  layer_t *l;
+  char *e;
+  long v;
+  size_t n;
+
+  o->layer_count = 0;
+  for (;;) {
+    n = strcspn(s, ",");
+    if (o->layer_count == MAX_LAYERS)
+      die("too many layers: %s", optarg);
+    l = &o->layers[o->layer_count++];
+    if (n == 8 && !strncmp(s, "walkable", n)) {
+      l->type = LAYER_WALKABLE;
+    } else if (n == 6 && !strncmp(s, "height", n)) {
+      l->type = LAYER_HEIGHT;
+    } else {
+      v = strtol(s, &e, 10);
+      if (e != s + n || !n || v < 0 || v > 255)
+        die("invalid layer: %.*s", (int) n, s);
+      l->type = LAYER_VALUE;
+      l->value = v;
+    }
+    if (!s[n])
+      break;
+    s += n + 1;
+  }
+}
+
 int options_parse(int c, char **a) {
   options_t *o = &options;
   int v;
   memset(o, 0, sizeof *o);
-  while (-1 != (v = getopt(c, a, "ho:s:"))) {
+  while (-1 != (v = getopt(c, a, "hd:j:l:o:s:"))) {
     switch (v) {
+    case 'd':
+      o->depth = atoi(optarg);
+      if (o->depth != 1 && o->depth != 8)
+        die("invalid depth argument: %s", optarg);
+      break;
+    case 'j':
+      if ((o->threads = atoi(optarg)) < 1)
+        die("invalid thread count: %s", optarg);
+      break;
+    case 'l':
+      parse_layers(optarg);
+      break;
     case 'o':
       o->output = optarg;
       break;
@@ -75,13 +140,18 @@ int options_parse(int c, char **a) {
   return optind;
 }
 
-void options_validate(void) {
+void options_validate(int maps) {
   options_t *o = &options;
   if (o->image_width < 1)
     o->image_width = 0;
   if (o->image_height < 1)
     o->image_height = 0;
+  if (!o->layer_count) {
+    o->layers[0].type = LAYER_WALKABLE;
+    o->layer_count = 1;
+  }
   if (!o->output)
-    o->output = DEFAULT_OUTPUT;
+    o->output = maps == 1 && o->layer_count == 1
+      ? DEFAULT_OUTPUT : DEFAULT_PATTERN;
 }
 
@@ -19,10 +19,27 @@
 #ifndef ELM_DRAW_TILES_OPTIONS_H
 #define ELM_DRAW_TILES_OPTIONS_H
 
+#define MAX_LAYERS 64
+
+typedef enum {
+  LAYER_WALKABLE,  /* tiles that are not zero */
+  LAYER_HEIGHT,    /* tile values as gray levels */
+  LAYER_VALUE      /* tiles of one value */
+} layer_type_t;
+
+typedef struct {
+  layer_type_t type;
+  int value;
+} layer_t;
+
 typedef struct {
   int image_width;
   int image_height;
+  int depth;
+  int threads;
   const char *output;
+  layer_t layers[MAX_LAYERS];
+  int layer_count;
 } options_t;
 
 extern options_t options;
@@ -30,6 +47,6 @@ extern options_t options;
 void options_usage(void)
   __attribute__((noreturn));
 int options_parse(int argc, char **argv);
-void options_validate(void);
+void options_validate(int maps);
 
 #endif /* ELM_DRAW_TILES_OPTIONS_H */
@@ -0,0 +1,169 @@
+/*
+ *  Copyright (C) 2014 Cole Minor
+ *  This file is part of elm-draw-tiles.
+ *
+ *  elm-draw-tiles is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  elm-draw-tiles is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "raster.h"
+
+#include "utility.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+struct raster {
+  const map_t *map;
+  const uint8_t *levels;
+  int width, height;
+  int exact;
+  double tw, th;
+  /* coverage of the last map row drawn, and the row being drawn */
+  double *cover, *sum;
+  int cached;
+};
+
+/* Finds the end of the run of tiles from x in a row of w tiles that
+ * are all at the same level. */
+static int run_end(const uint8_t *t, const uint8_t *l, int w, int x) {
+  uint8_t v = l[t[x]];
+  while (++x < w && l[t[x]] == v)
+    ;
+  return x;
+}
+
+/* the map row shown at image tile row r */
+static const uint8_t *map_row(const map_t *m, int r) {
+  return m->tiles + (size_t) m->width * (m->height - 1 - r);
+}
+
+/* Every tile is sx pixels wide, so the row is filled as runs. */
+static void exact_row(const raster_t *r, int tr, int sx, uint8_t *row) {
+  const map_t *m = r->map;
+  const uint8_t *t = map_row(m, tr), *l = r->levels;
+  int x, e;
+
+  for (x = 0; x < m->width; x = e) {
+    e = run_end(t, l, m->width, x);
+    memset(row + (size_t) x * sx, l[t[x]], (size_t) (e - x) * sx);
+  }
+}
+
+/* Adds v times the part of each of n pixels that a..b covers. */
+static void add_span(double *c, int n, double a, double b, double v) {
+  int i, j, k;
+
+  if (b > n)
+    b = n;
+  if (a >= b)
+    return;
+  i = a;
+  j = b;
+  if (i == j) {
+    c[i] += (b - a) * v;
+    return;
+  }
+  c[i] += (i + 1 - a) * v;
+  for (k = i + 1; k < j; k++)
+    c[k] += v;
+  if (j < n)
+    c[j] += (b - j) * v;
+}
+
+/* Sets the coverage of each pixel in a row by the tiles at image
+ * tile row tr, weighted by their levels. */
+static void cover_row(raster_t *r, int tr) {
+  const map_t *m = r->map;
+  const uint8_t *t = map_row(m, tr), *l = r->levels;
+  int x, e;
+
+  memset(r->cover, 0, r->width * sizeof *r->cover);
+  for (x = 0; x < m->width; x = e) {
+    e = run_end(t, l, m->width, x);
+    if (l[t[x]])
+      add_span(r->cover, r->width, x * r->tw, e * r->tw, l[t[x]]);
+  }
+  r->cached = tr;
+}
+
+/* Otherwise each pixel is the mean level of the tiles over it,
+ * weighted by the area of it they cover. */
+static void covered_row(raster_t *r, int y, uint8_t *row) {
+  double y0 = y / r->th, y1 = (y + 1) / r->th, w, v;
+  int x, t;
+
+  memset(r->sum, 0, r->width * sizeof *r->sum);
+  for (t = y0; t < r->map->height && t < y1; t++) {
+    w = ((y1 < t + 1 ? y1 : t + 1) - (y0 > t ? y0 : t)) * r->th;
+    if (w <= 0)
+      continue;
+    if (t != r->cached)
+      cover_row(r, t);
+    for (x = 0; x < r->width; x++)
+      r->sum[x] += w * r->cover[x];
+  }
+  for (x = 0; x < r->width; x++) {
+    v = r->sum[x] < 255 ? r->sum[x] : 255;
+    row[x] = lround(v);
+  }
+}
+
+int raster_exact(const map_t *m, int width, int height) {
+  return m->width && m->height
+    && width % m->width == 0 && height % m->height == 0;
+}
+
+raster_t *raster_new(const map_t *m, int width, int height,
+                     const uint8_t *levels) {
+  raster_t *r;
+
+  if (!(r = calloc(1, sizeof *r)))
+    die("out of memory");
+  r->map = m;
+  r->levels = levels;
+  r->width = width;
+  r->height = height;
+  r->exact = raster_exact(m, width, height);
+  r->cached = -1;
+  if (!r->exact && m->width && m->height) {
+    r->tw = (double) width / m->width;
+    r->th = (double) height / m->height;
+    r->cover = malloc(width * sizeof *r->cover);
+    r->sum = malloc(width * sizeof *r->sum);
+    if (!r->cover || !r->sum)
+      die("out of memory");
+  }
+  return r;
+}
+
+void raster_free(raster_t *r) {
+  free(r->cover);
+  free(r->sum);
+  free(r);
+}
+
+void raster_row(raster_t *r, int y, uint8_t *row) {
+  const map_t *m = r->map;
+  int sy;
+
+  if (!m->width || !m->height) {
+    memset(row, 0, r->width);
+  } else if (r->exact) {
+    sy = r->height / m->height;
+    exact_row(r, y / sy, r->width / m->width, row);
+  } else {
+    covered_row(r, y, row);
+  }
+}
@@ -0,0 +1,42 @@
+/*
+ *  Copyright (C) 2014 Cole Minor
+ *  This file is part of elm-draw-tiles.
+ *
+ *  elm-draw-tiles is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  elm-draw-tiles is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef ELM_DRAW_TILES_RASTER_H
+#define ELM_DRAW_TILES_RASTER_H
+
+#include "map.h"
+
+#include <stdint.h>
+
+/* Draws the tiles of a map with north up, one row of 8-bit gray
+ * pixels at a time. Each tile is drawn at the gray level that levels
+ * gives for its value. */
+typedef struct raster raster_t;
+
+raster_t *raster_new(const map_t *m, int width, int height,
+                     const uint8_t *levels);
+void raster_free(raster_t *r);
+
+/* whether every tile is a whole number of pixels, so every pixel is
+ * at the level of a single tile */
+int raster_exact(const map_t *m, int width, int height);
+
+/* Draws image row y into width bytes of row. */
+void raster_row(raster_t *r, int y, uint8_t *row);
+
+#endif /* ELM_DRAW_TILES_RASTER_H */
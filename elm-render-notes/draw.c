@@ -24,6 +24,9 @@
 #include <pango/pangocairo.h>
 
 #include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 
 #define MARGIN 35.0
 #define FONT_OUTLINE_FRACTION (1.0 / 8.0)
@@ -33,6 +36,8 @@
 #define ANCHOR_SIZE 15.0
 #define SCALE_PART_LENGTH 66.0
 #define SCALE_HEIGHT 10.0
+#define SCALE_FONT_SIZE 28
+#define ICON_LABEL_OUTLINE 2.0
 
 typedef double color_t[3];
 
@@ -45,48 +50,299 @@ static void set_cairo_color(cairo_t *c, const color_t a) {
   cairo_set_source_rgba(c, a[0], a[1], a[2], 1);
 }
 
-static PangoLayout *create_label_layout(cairo_t *c, const note_t *n) {
+/* Kept with a cairo context until it is destroyed: a layout for each
+ * font size, and for each label text and size its extents and the
+ * outline paths made of it. Labels are looked for in the caches it
+ * shares first, which are only ever read. */
+typedef struct {
+  int size;
+  PangoLayout *layout;
+} font_t;
+
+/* A fresh outline starts from the current point, which cairo keeps
+ * in 24.8 fixed point, and each glyph's outline is added in fixed
+ * point from there, rounding ties to even. An outline made at the
+ * fractional part of a label's origin in those units, and moved by
+ * whole pixels, so by an even number of units, has the very vertices
+ * of one made at the origin itself. */
+typedef struct outline {
+  struct outline *next;
+  int phase_x, phase_y;   /* in 1/256 pixel */
+  double top, bottom;     /* of the path */
+  cairo_path_t *path;
+} outline_t;
+
+typedef struct label {
+  struct label *next;
+  int size;
+  PangoRectangle extents;
+  outline_t *outlines;
+  char text[];
+} label_t;
+
+#define LABEL_BUCKETS 1024
+
+typedef struct cache {
+  const struct cache **shared;
+  int shared_count;
+  font_t *fonts;
+  int font_count;
+  label_t *labels[LABEL_BUCKETS];
+} cache_t;
+
+static const cairo_user_data_key_t cache_key;
+
+static void free_cache(void *p) {
+  cache_t *k = p;
+  label_t *l, *n;
+  outline_t *o, *q;
+  int i;
+  for (i = 0; i < k->font_count; i++)
+    g_object_unref(k->fonts[i].layout);
+  free(k->fonts);
+  free(k->shared);
+  for (i = 0; i < LABEL_BUCKETS; i++) {
+    for (l = k->labels[i]; l; l = n) {
+      n = l->next;
+      for (o = l->outlines; o; o = q) {
+        q = o->next;
+        cairo_path_destroy(o->path);
+        free(o);
+      }
+      free(l);
+    }
+  }
+  free(k);
+}
+
+static cache_t *get_cache(cairo_t *c) {
+  cache_t *k;
+  if (!(k = cairo_get_user_data(c, &cache_key))) {
+    if (!(k = calloc(1, sizeof *k)))
+      die("out of memory");
+    cairo_set_user_data(c, &cache_key, k, free_cache);
+  }
+  return k;
+}
+
+void draw_share_labels(cairo_t *c, cairo_t *from) {
+  const cache_t **s;
+  cache_t *k, *f;
+
+  if (!(f = cairo_get_user_data(from, &cache_key)))
+    return;
+  k = get_cache(c);
+  if (!(s = realloc(k->shared, (k->shared_count + 1) * sizeof *s)))
+    die("out of memory");
+  k->shared = s;
+  s[k->shared_count++] = f;
+}
+
+static PangoLayout *get_font_layout(cairo_t *c, int s) {
   PangoFontDescription *d;
   PangoLayout *l;
+  cache_t *k;
+  font_t *f;
   char b[256];
-  const char *f, *t;
-  int s;
+  int i;
 
-  t = note_get_label(n);
-  s = note_get_font_size(n);
-  f = options.font_name;
-  snprintf(b, sizeof b, "%s %dpx", f, s);
+  k = get_cache(c);
+  for (i = 0; i < k->font_count; i++)
+    if (k->fonts[i].size == s)
+      return k->fonts[i].layout;
 
+  snprintf(b, sizeof b, "%s %dpx", options.font_name, s);
   l = pango_cairo_create_layout(c);
-  pango_layout_set_text(l, t, -1);
   d = pango_font_description_from_string(b);
   pango_layout_set_font_description(l, d);
   pango_font_description_free(d);
 
-  cairo_set_line_width(c, s * FONT_OUTLINE_FRACTION);
+  if (!(f = realloc(k->fonts, (k->font_count + 1) * sizeof *f)))
+    die("out of memory");
+  k->fonts = f;
+  f[k->font_count].size = s;
+  f[k->font_count].layout = l;
+  k->font_count++;
+  return l;
+}
 
+static unsigned label_hash(const char *t, int s) {
+  unsigned h = s;
+  while (*t)
+    h = h * 31 + (unsigned char) *t++;
+  return h % LABEL_BUCKETS;
+}
+
+static label_t *find_label(const cache_t *k, unsigned h,
+                           const char *t, int s) {
+  label_t *l;
+  for (l = k->labels[h]; l; l = l->next)
+    if (l->size == s && !strcmp(l->text, t))
+      return l;
+  return NULL;
+}
+
+static PangoLayout *get_text_layout(cairo_t *c, const char *t, int s) {
+  PangoLayout *p;
+  p = get_font_layout(c, s);
+  pango_layout_set_text(p, t, -1);
+  pango_cairo_update_layout(c, p);
+  return p;
+}
+
+/* Finds or makes the label on c's own cache. */
+static label_t *make_label(cairo_t *c, const char *t, int s) {
+  cache_t *k;
+  label_t *l;
+  unsigned h;
+  size_t n;
+
+  k = get_cache(c);
+  h = label_hash(t, s);
+  if ((l = find_label(k, h, t, s)))
+    return l;
+
+  n = strlen(t) + 1;
+  if (!(l = malloc(sizeof *l + n)))
+    die("out of memory");
+  memcpy(l->text, t, n);
+  l->size = s;
+  l->outlines = NULL;
+  pango_layout_get_pixel_extents(get_text_layout(c, t, s), NULL,
+                                 &l->extents);
+
+  l->next = k->labels[h];
+  k->labels[h] = l;
   return l;
 }
 
-static void draw_point_label(cairo_t *c, const note_t *n) {
+static const label_t *get_label(cairo_t *c, const char *t, int s) {
+  cache_t *k;
+  label_t *l;
+  unsigned h;
+  int i;
+
+  k = get_cache(c);
+  h = label_hash(t, s);
+  for (i = 0; i < k->shared_count; i++)
+    if ((l = find_label(k->shared[i], h, t, s)))
+      return l;
+  return make_label(c, t, s);
+}
+
+static const outline_t *find_outline(const label_t *l, int x, int y) {
+  const outline_t *o;
+  for (o = l->outlines; o; o = o->next)
+    if (o->phase_x == x && o->phase_y == y)
+      return o;
+  return NULL;
+}
+
+/* The outline of a label at x, y and the whole pixels it is to be
+ * moved by, made on c's own cache if no cache has it yet. */
+static const outline_t *get_outline(cairo_t *c, const label_t *l,
+                                    double x, double y,
+                                    double *dx, double *dy) {
+  const outline_t *f;
+  const label_t *q;
+  outline_t *o;
+  label_t *m;
+  cache_t *k;
+  double fx, fy, x0, x1;
+  unsigned h;
+  int i, px, py;
+
+  fx = nearbyint(x * 256.0);
+  fy = nearbyint(y * 256.0);
+  *dx = floor(fx / 256.0);
+  *dy = floor(fy / 256.0);
+  px = fx - *dx * 256.0;
+  py = fy - *dy * 256.0;
+  if ((f = find_outline(l, px, py)))
+    return f;
+  k = get_cache(c);
+  h = label_hash(l->text, l->size);
+  for (i = 0; i < k->shared_count; i++) {
+    q = find_label(k->shared[i], h, l->text, l->size);
+    if (q && (f = find_outline(q, px, py)))
+      return f;
+  }
+  m = make_label(c, l->text, l->size);
+  if ((f = find_outline(m, px, py)))
+    return f;
+
+  if (!(o = malloc(sizeof *o)))
+    die("out of memory");
+  o->phase_x = px;
+  o->phase_y = py;
+  cairo_new_path(c);
+  cairo_move_to(c, px / 256.0, py / 256.0);
+  pango_cairo_layout_path(c, get_text_layout(c, m->text, m->size));
+  cairo_path_extents(c, &x0, &o->top, &x1, &o->bottom);
+  o->path = cairo_copy_path(c);
+  cairo_new_path(c);
+
+  o->next = m->outlines;
+  m->outlines = o;
+  return o;
+}
+
+static const label_t *get_note_label(cairo_t *c, const note_t *n) {
+  int s;
+
+  s = note_get_font_size(n);
+  cairo_set_line_width(c, s * FONT_OUTLINE_FRACTION);
+
+  return get_label(c, note_get_label(n), s);
+}
+
+static void draw_label(cairo_t *c, const label_t *l, double x, double y) {
+  const outline_t *o;
+  double dx, dy;
+
+  o = get_outline(c, l, x, y, &dx, &dy);
+  cairo_save(c);
+  cairo_translate(c, dx, dy);
+  cairo_append_path(c, o->path);
+  cairo_restore(c);
+  set_cairo_color(c, black);
+  cairo_stroke_preserve(c);
+  set_cairo_color(c, white);
+  cairo_fill(c);
+}
+
+/* Widens top and bottom to cover a label at x, y outlined with lines
+ * w wide. Miter joins can reach out to half the line width times the
+ * default miter limit of 10, and antialiasing one pixel further. */
+static void add_label_extents(cairo_t *c, const label_t *l,
+                              double x, double y, double w,
+                              double *top, double *bottom) {
+  const outline_t *o;
+  double dx, dy, m;
+
+  o = get_outline(c, l, x, y, &dx, &dy);
+  m = 5.0 * w + 1.0;
+  if (dy + o->top - m < *top)
+    *top = dy + o->top - m;
+  if (dy + o->bottom + m > *bottom)
+    *bottom = dy + o->bottom + m;
+}
+
+static const label_t *locate_point_label(cairo_t *c, const note_t *n,
+                                         double *lx, double *ly) {
   char o;
   double d, x, y, w, h, s;
-  PangoRectangle r;
-  PangoLayout *l;
+  const label_t *l;
 
   o = n->text[1];
   if (!o)
-    return;
-
-  l = create_label_layout(c, n);
+    return NULL;
 
-  set_cairo_color(c, black);
-  pango_cairo_update_layout(c, l);
-  pango_layout_get_pixel_extents(l, NULL, &r);
+  l = get_note_label(c, n);
 
   d = POINT_RADIUS + POINT_OUTLINE;
-  w = r.width;
-  h = r.height;
+  w = l->extents.width;
+  h = l->extents.height;
   s = 2.0;
   switch (o) {
   case 'l':
@@ -109,13 +365,16 @@ static void draw_point_label(cairo_t *c, const note_t *n) {
     die("unrecognized point label orientation "
         "'%c' for note: '%s'", o, n->text);
   }
-  cairo_move_to(c, n->x + x, n->y + y);
-  pango_cairo_layout_path(c, l);
-  cairo_stroke_preserve(c);
-  set_cairo_color(c, white);
-  cairo_fill(c);
+  *lx = n->x + x;
+  *ly = n->y + y;
+  return l;
+}
 
-  g_object_unref(l);
+static void draw_point_label(cairo_t *c, const note_t *n) {
+  const label_t *l;
+  double x, y;
+  if ((l = locate_point_label(c, n, &x, &y)))
+    draw_label(c, l, x, y);
 }
 
 void draw_point(cairo_t *c, const note_t *n) {
@@ -141,33 +400,35 @@ void draw_point(cairo_t *c, const note_t *n) {
   draw_point_label(c, n);
 }
 
-void draw_place(cairo_t *c, const note_t *n) {
-  PangoLayout *l;
-  PangoRectangle r;
+static const label_t *locate_place_label(cairo_t *c, const note_t *n,
+                                         double *lx, double *ly) {
+  const label_t *l;
+  const PangoRectangle *r;
   double x, y;
 
-  l = create_label_layout(c, n);
+  l = get_note_label(c, n);
+  r = &l->extents;
 
-  set_cairo_color(c, black);
-  pango_cairo_update_layout(c, l);
-  pango_layout_get_pixel_extents(l, NULL, &r);
-  x = n->x - 0.5 * r.width;
-  y = n->y - 0.5 * r.height;
+  x = n->x - 0.5 * r->width;
+  y = n->y - 0.5 * r->height;
   while (x - MARGIN < 0.0)
     x += 4.0;
   while (y - MARGIN < 0.0)
     y += 4.0;
-  while (x + r.width + MARGIN > options.image_width)
+  while (x + r->width + MARGIN > options.image_width)
     x -= 4.0;
-  while (y + r.height + MARGIN > options.image_height)
+  while (y + r->height + MARGIN > options.image_height)
     y -= 4.0;
-  cairo_move_to(c, x, y);
-  pango_cairo_layout_path(c, l);
-  cairo_stroke_preserve(c);
-  set_cairo_color(c, white);
-  cairo_fill(c);
+  *lx = x;
+  *ly = y;
+  return l;
+}
 
-  g_object_unref(l);
+void draw_place(cairo_t *c, const note_t *n) {
+  const label_t *l;
+  double x, y;
+  l = locate_place_label(c, n, &x, &y);
+  draw_label(c, l, x, y);
 }
 
 static double get_arrow_rotation(const note_t *n) {
@@ -238,77 +499,71 @@ static void draw_anchor(cairo_t *c, const note_t *n) {
   cairo_restore(c);
 }
 
-void draw_icon(cairo_t *c, const note_t *n) {
-  double w, x, y;
-  PangoLayout *l;
-  PangoRectangle r;
+static double get_icon_size(const note_t *n) {
+  return n->text[0] == '@' ? ANCHOR_SIZE : ARROW_SIZE;
+}
 
-  if (n->text[0] == '@') {
-    draw_anchor(c, n);
-    w = ANCHOR_SIZE;
-  } else {
-    draw_arrow(c, n);
-    w = ARROW_SIZE;
-  }
+static const label_t *locate_icon_label(cairo_t *c, const note_t *n,
+                                        double *lx, double *ly) {
+  double w, x, y;
+  const label_t *l;
+  const PangoRectangle *r;
 
-  l = create_label_layout(c, n);
+  w = get_icon_size(n);
+  l = get_note_label(c, n);
+  r = &l->extents;
 
-  set_cairo_color(c, black);
-  cairo_set_line_width(c, 2);
-  pango_cairo_update_layout(c, l);
-  pango_layout_get_pixel_extents(l, NULL, &r);
   x = n->x + 0.5 * w;
-  y = n->y - 0.5 * r.height;
-  if (x + r.width + MARGIN > options.image_width)
-    x = n->x - 0.5 * w - r.width;
-  cairo_move_to(c, x, y);
-  pango_cairo_layout_path(c, l);
-  cairo_stroke_preserve(c);
-  set_cairo_color(c, white);
-  cairo_fill(c);
+  y = n->y - 0.5 * r->height;
+  if (x + r->width + MARGIN > options.image_width)
+    x = n->x - 0.5 * w - r->width;
+  *lx = x;
+  *ly = y;
+  return l;
+}
 
-  g_object_unref(l);
+void draw_icon(cairo_t *c, const note_t *n) {
+  const label_t *l;
+  double x, y;
+
+  if (n->text[0] == '@')
+    draw_anchor(c, n);
+  else
+    draw_arrow(c, n);
+
+  l = locate_icon_label(c, n, &x, &y);
+  cairo_set_line_width(c, ICON_LABEL_OUTLINE);
+  draw_label(c, l, x, y);
 }
 
-static void draw_scale_label(cairo_t *c, const note_t *n) {
-  PangoFontDescription *d;
-  PangoLayout *l;
-  PangoRectangle r;
-  const char *f;
+static const label_t *locate_scale_label(cairo_t *c, const note_t *n,
+                                         double *lx, double *ly) {
+  const label_t *l;
   char b[256];
-  int s, i;
-  double v, x, y;
+  int i;
+  double v;
   const options_t *o;
 
   o = &options;
-  f = o->font_name;
-  s = 28;
-  snprintf(b, sizeof b, "%s %dpx", f, s);
-  d = pango_font_description_from_string(b);
-
-  l = pango_cairo_create_layout(c);
   v = 2.0 * SCALE_PART_LENGTH
       * o->scale_multiplier
       * o->map_width / o->image_width;
   i = round(v);
   snprintf(b, sizeof b, "%d", i);
-  pango_layout_set_text(l, b, -1);
-  pango_layout_set_font_description(l, d);
-  pango_font_description_free(d);
+  l = get_label(c, b, SCALE_FONT_SIZE);
 
-  cairo_set_line_width(c, s * FONT_OUTLINE_FRACTION);
-  set_cairo_color(c, black);
-  pango_cairo_update_layout(c, l);
-  pango_layout_get_pixel_extents(l, NULL, &r);
-  x = n->x - 0.5 * r.width;
-  y = n->y + 0.5 * SCALE_HEIGHT;
-  cairo_move_to(c, x, y);
-  pango_cairo_layout_path(c, l);
-  cairo_stroke_preserve(c);
-  set_cairo_color(c, white);
-  cairo_fill(c);
+  *lx = n->x - 0.5 * l->extents.width;
+  *ly = n->y + 0.5 * SCALE_HEIGHT;
+  return l;
+}
+
+static void draw_scale_label(cairo_t *c, const note_t *n) {
+  const label_t *l;
+  double x, y;
 
-  g_object_unref(l);
+  l = locate_scale_label(c, n, &x, &y);
+  cairo_set_line_width(c, SCALE_FONT_SIZE * FONT_OUTLINE_FRACTION);
+  draw_label(c, l, x, y);
 }
 
 void draw_scale(cairo_t *c, const note_t *n) {
@@ -329,3 +584,54 @@ void draw_scale(cairo_t *c, const note_t *n) {
 
   draw_scale_label(c, n);
 }
+
+void draw_point_extents(cairo_t *c, const note_t *n,
+                        double *top, double *bottom) {
+  const label_t *l;
+  double x, y, d;
+
+  d = POINT_RADIUS + POINT_OUTLINE + 1.0;
+  *top = n->y - d;
+  *bottom = n->y + d;
+  if ((l = locate_point_label(c, n, &x, &y)))
+    add_label_extents(c, l, x, y,
+                      note_get_font_size(n) * FONT_OUTLINE_FRACTION,
+                      top, bottom);
+}
+
+void draw_place_extents(cairo_t *c, const note_t *n,
+                        double *top, double *bottom) {
+  const label_t *l;
+  double x, y;
+
+  l = locate_place_label(c, n, &x, &y);
+  *top = y;
+  *bottom = y;
+  add_label_extents(c, l, x, y,
+                    note_get_font_size(n) * FONT_OUTLINE_FRACTION,
+                    top, bottom);
+}
+
+void draw_icon_extents(cairo_t *c, const note_t *n,
+                       double *top, double *bottom) {
+  const label_t *l;
+  double x, y;
+
+  /* both icons stay well within this */
+  *top = n->y - ARROW_SIZE;
+  *bottom = n->y + ARROW_SIZE;
+  l = locate_icon_label(c, n, &x, &y);
+  add_label_extents(c, l, x, y, ICON_LABEL_OUTLINE, top, bottom);
+}
+
+void draw_scale_extents(cairo_t *c, const note_t *n,
+                        double *top, double *bottom) {
+  const label_t *l;
+  double x, y;
+
+  *top = n->y - 0.5 * SCALE_HEIGHT;
+  *bottom = n->y + 0.5 * SCALE_HEIGHT;
+  l = locate_scale_label(c, n, &x, &y);
+  add_label_extents(c, l, x, y, SCALE_FONT_SIZE * FONT_OUTLINE_FRACTION,
+                    top, bottom);
+}
@@ -28,6 +28,22 @@ void draw_place(cairo_t *c, const note_t *n);
 void draw_icon(cairo_t *c, const note_t *n);
 void draw_scale(cairo_t *c, const note_t *n);
 
+/* Rows of pixels the functions above may mark, top to bottom. */
+void draw_point_extents(cairo_t *c, const note_t *n,
+                        double *top, double *bottom);
+void draw_place_extents(cairo_t *c, const note_t *n,
+                        double *top, double *bottom);
+void draw_icon_extents(cairo_t *c, const note_t *n,
+                       double *top, double *bottom);
+void draw_scale_extents(cairo_t *c, const note_t *n,
+                        double *top, double *bottom);
+
+/* Lets c draw the labels already made on from, whose user space
+ * must be the same. It may be called for several contexts. Each must
+ * outlive c and make no more labels, so contexts on several threads
+ * can share them. */
+void draw_share_labels(cairo_t *c, cairo_t *from);
+
 /* symbol, color name, R, G, B */
 #define X_POINTS(X) \
   X(w, white, 1, 1, 1) \
@@ -16,6 +16,7 @@
  *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *
  */
+#include "draw.h"
 #include "image.h"
 #include "note.h"
 #include "options.h"
@@ -23,39 +24,235 @@
 #include "utility.h"
 
 #include <errno.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
-static void render_notes(const char *p) {
-  cairo_surface_t *s;
-  cairo_t *c;
+/* rows of the image and the notes, in file order, marking them */
+typedef struct {
+  int top, height;
+  int *notes;
+  int count, size;
+} band_t;
+
+static note_t *notes;
+static char **lines;
+static int note_count;
+static band_t *bands;
+static int band_count;
+static int next_band;
+/* contexts the notes are measured on, which keep their labels for
+ * the bands, and the rows each note reaches */
+static cairo_t **measures;
+static int measure_count;
+static int next_note;
+static double *tops, *bottoms;
+static unsigned char *pixels;
+static int stride;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+
+static void read_notes(const char *p) {
   char b[1024];
-  const char *o;
-  note_t _n, *n = &_n;
+  char *t, **u;
+  note_t *n;
   FILE *f;
-  int l;
+  int l, size = 0;
 
   if (!(f = fopen(p, "r")))
     die("failed to open '%s': %s", p, strerror(errno));
 
-  s = image_create();
-  c = cairo_create(s);
   for (l = 1; fgets(b, sizeof b, f); l++) {
     chomp(b);
-    if (!note_parse(n, b))
+    if (note_count == size) {
+      size = size ? 2 * size : 256;
+      if (!(n = realloc(notes, size * sizeof *n)))
+        die("out of memory");
+      notes = n;
+      if (!(u = realloc(lines, size * sizeof *u)))
+        die("out of memory");
+      lines = u;
+    }
+    n = &notes[note_count];
+    if (!(t = lines[note_count] = strdup(b)))
+      die("out of memory");
+    if (!note_parse(n, t))
       die("invalid note on line %d: '%s'", l, b);
     if (!note_convert_coordinates(n))
       die("invalid map tile coordinates "
           "on line %d: '%s'", l, b);
-    note_draw(n, c);
+    note_count++;
   }
   fclose(f);
+}
+
+static void add_band_note(band_t *b, int i) {
+  int *t;
+  if (b->count == b->size) {
+    b->size = b->size ? 2 * b->size : 256;
+    if (!(t = realloc(b->notes, b->size * sizeof *t)))
+      die("out of memory");
+    b->notes = t;
+  }
+  b->notes[b->count++] = i;
+}
+
+/* notes measured at a time by a thread */
+#define NOTE_CHUNK 64
+
+static void run_threads(int n, void *(*f)(void *), void **args) {
+  pthread_t *t;
+  int i;
+
+  if (!(t = malloc(n * sizeof *t)))
+    die("out of memory");
+  for (i = 0; i < n; i++) {
+    if ((errno = pthread_create(&t[i], 0, f, args ? args[i] : 0)))
+      die("pthread_create failed: %s", strerror(errno));
+  }
+  for (i = 0; i < n; i++)
+    pthread_join(t[i], 0);
+  free(t);
+}
+
+/* Each thread measures notes on a context of its own, making their
+ * labels there for the bands to draw. */
+static void *measure_notes(void *a) {
+  cairo_t *c = a;
+  int i, j;
+  for (;;) {
+    pthread_mutex_lock(&lock);
+    i = next_note;
+    next_note += NOTE_CHUNK;
+    pthread_mutex_unlock(&lock);
+    if (i >= note_count)
+      break;
+    for (j = i; j < i + NOTE_CHUNK && j < note_count; j++)
+      note_get_extents(&notes[j], c, &tops[j], &bottoms[j]);
+  }
+  return 0;
+}
+
+/* Splits the image into a band for each thread and adds each note to
+ * the bands it reaches into. */
+static void bin_notes(cairo_surface_t *s, int threads) {
+  double t, b;
+  int i, j, h, first, last;
+
+  h = options.image_height;
+  band_count = threads < h ? threads : h;
+  if (!(bands = calloc(band_count, sizeof *bands)))
+    die("out of memory");
+  for (i = 0; i < band_count; i++) {
+    bands[i].top = (long) h * i / band_count;
+    bands[i].height = (long) h * (i + 1) / band_count - bands[i].top;
+  }
+
+  if (band_count == 1 || !note_count) {
+    for (i = 0; i < note_count; i++)
+      add_band_note(&bands[0], i);
+    return;
+  }
+
+  measure_count = band_count;
+  if (!(measures = malloc(measure_count * sizeof *measures))
+      || !(tops = malloc(note_count * sizeof *tops))
+      || !(bottoms = malloc(note_count * sizeof *bottoms)))
+    die("out of memory");
+  for (i = 0; i < measure_count; i++)
+    measures[i] = cairo_create(s);
+  run_threads(measure_count, measure_notes, (void **) measures);
+
+  for (i = 0; i < note_count; i++) {
+    t = tops[i];
+    b = bottoms[i];
+    if (b < 0 || t >= h)
+      continue;
+    first = 0;
+    last = band_count - 1;
+    while (first < last && bands[first + 1].top <= floor(t))
+      first++;
+    while (last > first && bands[last].top > floor(b))
+      last--;
+    for (j = first; j <= last; j++)
+      add_band_note(&bands[j], i);
+  }
+  free(tops);
+  free(bottoms);
+}
+
+/* Each band draws straight into its own rows of the image through
+ * a surface of its own, offset so notes keep their coordinates. */
+static void render_band(const band_t *b) {
+  cairo_surface_t *s;
+  cairo_t *c;
+  int i;
+
+  s = cairo_image_surface_create_for_data(pixels + (size_t) b->top * stride,
+                                          CAIRO_FORMAT_ARGB32,
+                                          options.image_width,
+                                          b->height, stride);
+  cairo_surface_set_device_offset(s, 0, -b->top);
+  c = cairo_create(s);
+  for (i = 0; i < measure_count; i++)
+    draw_share_labels(c, measures[i]);
+  for (i = 0; i < b->count; i++)
+    note_draw(&notes[b->notes[i]], c);
   cairo_destroy(c);
+  cairo_surface_destroy(s);
+}
+
+static void *render_bands(void *a) {
+  int i;
+  (void) a;
+  for (;;) {
+    pthread_mutex_lock(&lock);
+    i = next_band++;
+    pthread_mutex_unlock(&lock);
+    if (i >= band_count)
+      break;
+    render_band(&bands[i]);
+  }
+  return 0;
+}
+
+static void render_notes(const char *p) {
+  cairo_surface_t *s;
+  const char *o;
+  int i, threads;
+
+  read_notes(p);
+
+  threads = options.threads;
+  if (!threads && (threads = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+    threads = 1;
+
+  s = image_create();
+  bin_notes(s, threads);
+  cairo_surface_flush(s);
+  pixels = cairo_image_surface_get_data(s);
+  stride = cairo_image_surface_get_stride(s);
+
+  run_threads(band_count, render_bands, 0);
+  for (i = 0; i < measure_count; i++)
+    cairo_destroy(measures[i]);
+  free(measures);
+  cairo_surface_mark_dirty(s);
 
   o = options.output;
   cairo_surface_write_to_png(s, o);
   cairo_surface_destroy(s);
   printf("wrote image to '%s'\n", o);
+
+  for (i = 0; i < band_count; i++)
+    free(bands[i].notes);
+  free(bands);
+  for (i = 0; i < note_count; i++)
+    free(lines[i]);
+  free(lines);
+  free(notes);
 }
 
 int main(int argc, char **argv) {
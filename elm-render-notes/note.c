@@ -84,6 +84,27 @@ void note_draw(const note_t *n, cairo_t *c) {
   }
 }
 
+void note_get_extents(const note_t *n, cairo_t *c,
+                      double *top, double *bottom) {
+  switch (n->text[0]) {
+  case '.':
+  case '=':
+    draw_place_extents(c, n, top, bottom);
+    break;
+  case '#':
+  case '>':
+  case '@':
+    draw_icon_extents(c, n, top, bottom);
+    break;
+  case 's':
+    draw_scale_extents(c, n, top, bottom);
+    break;
+  default:
+    draw_point_extents(c, n, top, bottom);
+    break;
+  }
+}
+
 int note_get_font_size(const note_t *n) {
   const options_t *o = &options;
   switch (n->text[0]) {
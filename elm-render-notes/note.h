@@ -31,5 +31,7 @@ int note_convert_coordinates(note_t *n);
 const char *note_get_label(const note_t *n);
 int note_get_font_size(const note_t *n);
 void note_draw(const note_t *n, cairo_t *c);
+void note_get_extents(const note_t *n, cairo_t *c,
+                      double *top, double *bottom);
 
 #endif /* ELM_NOTE_RENDER_NOTE_H */
@@ -41,6 +41,7 @@ void options_usage(void) {
     "Options:\n"
     "  -f FONT          font name used for text\n"
     "  -i WIDTH,HEIGHT  image dimensions in pixels\n"
+    "  -j THREADS       number of image bands drawn at once\n"
     "  -l               list place name short forms\n"
     "  -m WIDTH,HEIGHT  map dimensions in tiles\n"
     "  -n               print note format help\n"
@@ -59,6 +60,10 @@ void options_usage(void) {
     "written to '" DEFAULT_OUTPUT "' in the current\n"
     "directory.\n"
     "\n"
+    "The image is split into horizontal bands that\n"
+    "are drawn at once, one for each processor if\n"
+    "the -j option is omitted.\n"
+    "\n"
     "Use the -n option for a detailed description\n"
     "of the note file syntax.\n";
   puts(u);
@@ -127,7 +132,7 @@ int options_parse(int c, char **a) {
   options_t *o = &options;
   int v;
   memset(o, 0, sizeof *o);
-  while (-1 != (v = getopt(c, a, "f:hi:lm:no:p:r:s:t:v"))) {
+  while (-1 != (v = getopt(c, a, "f:hi:j:lm:no:p:r:s:t:v"))) {
     const char *s = optarg;
     switch (v) {
     case 'f':
@@ -139,6 +144,10 @@ int options_parse(int c, char **a) {
     case 'h':
       options_usage();
       break;
+    case 'j':
+      if ((o->threads = atoi(s)) < 1)
+        die("invalid thread count: %s", s);
+      break;
     case 'l':
       print_place_names();
       break;
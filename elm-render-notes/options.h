@@ -30,6 +30,7 @@ typedef struct {
   int route_size;
   const char *output;
   double scale_multiplier;
+  int threads;
 } options_t;
 
 extern options_t options;
@@ -16,14 +16,39 @@
  * along with this program.  If not, see <http://www.gnu.org/licenses/>.
  *
  */
-
 #include <errno.h>
+#include <getopt.h>
 #include <inttypes.h>
+#include <math.h>
+#include <pthread.h>
 #include <stdarg.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <zlib.h>
+#include <unistd.h>
+
+#include "elm.h"
+#include "stats.h"
+
+enum { TEXT, CSV, JSON };
+
+typedef struct {
+  const char *path;
+  elm_header_t header;
+  stats_t stats;
+  char error[512];
+  int failed;
+  int done;
+} record_t;
+
+/* Headers are read on a pool of threads, each taking the next file
+ * in turn, and printed in argument order as they become done. */
+static record_t *records;
+static int record_count;
+static int next_record;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t record_done = PTHREAD_COND_INITIALIZER;
+static int show_stats;
 
 static void die(const char *f, ...) {
   char b[1024];
@@ -35,132 +60,336 @@ static void die(const char *f, ...) {
   exit(1);
 }
 
-static int big_endian(void) {
-  const union {
-    uint32_t i;
-    uint8_t b[4];
-  } u = { 0x01020304 };
-  return u.b[0] == 1;
+static void usage(const char *p) {
+  printf("Usage: %s [options] MAP...\n"
+         "\n"
+         "Options:\n"
+         "  -f FORMAT   text, csv or json, default text\n"
+         "  -j THREADS  number of files read at once\n"
+         "  -s          also read every section for statistics\n"
+         "              and consistency checks\n"
+         "\n"
+         "MAP is a ELM file, optionally gzip compressed.\n"
+         "\n"
+         "With csv or json, there is one record per map in\n"
+         "argument order, and maps that fail to read have\n"
+         "only an error field.\n"
+         "\n"
+         "With -s, the exit status is 1 if any map has a\n"
+         "problem.\n",
+         p);
+  exit(1);
 }
 
-static uint32_t extract_uint32_t(const uint8_t *b) {
-  const uint32_t *p = (const uint32_t *) b;
-  uint32_t v;
-  if (big_endian()) {
-    v = __builtin_bswap32(*p);
-  } else {
-    v = *p;
-  }
-  return v;
-}
-
-static uint8_t extract_uint8_t(const uint8_t *b) {
-  return *b;
-}
-
-static float extract_float(const uint8_t *b) {
-  union {
-    uint32_t i;
-    float f;
-  } u;
-  u.i = extract_uint32_t(b);
-  return u.f;
-}
-
-static void read_header(const char *p, uint8_t *b, int l) {
-  gzFile f;
-  int n;
-  if (!(f = gzopen(p, "rb"))) {
-    die("%s: gzopen failed: %s", p, strerror(errno));
-  }
-  n = gzread(f, b, l);
-  if (n == -1) {
-    die("%s: gzread failed: %s", p, strerror(errno));
-  }
-  if (n != l) {
-    die("%s: failed to read a complete map header "
-        " (tried to read %d bytes, but got only %d)",
-        p, l, n);
-  }
-  gzclose(f);
-  if (memcmp("elmf", b, 4)) {
-    die("%s: map file signature not found", p);
-  }
-}
-
-/* arguments: type, name */
-#define X_ELEMENTS(X) \
-  X(uint32_t, _signature) \
-  X(uint32_t, terrain_x) \
-  X(uint32_t, terrain_y) \
-  X(uint32_t, terrain_offset) \
-  X(uint32_t, tile_offset) \
-  X(uint32_t, mesh_size) \
-  X(uint32_t, mesh_count) \
-  X(uint32_t, mesh_offset) \
-  X(uint32_t, quad_size) \
-  X(uint32_t, quad_count) \
-  X(uint32_t, quad_offset) \
-  X(uint32_t, light_size) \
-  X(uint32_t, light_count) \
-  X(uint32_t, light_offset) \
-  X(uint8_t, internal) \
-  X(uint8_t, version) \
-  X(uint8_t, _unused1) \
-  X(uint8_t, _unused2) \
-  X(float, ambient_red) \
-  X(float, ambient_green) \
-  X(float, ambient_blue) \
-  X(uint32_t, fuzz_size) \
-  X(uint32_t, fuzz_count) \
-  X(uint32_t, fuzz_offset) \
-  X(uint32_t, segment_offset)
+static void read_record(record_t *r) {
+  elm_t *m;
+  if (!(m = elm_open(r->path, r->error, sizeof r->error))) {
+    r->failed = 1;
+    return;
+  }
+  r->header = *elm_header(m);
+  if (show_stats && stats_collect(m, &r->stats, r->error, sizeof r->error))
+    r->failed = 1;
+  elm_close(m);
+}
 
-typedef struct {
-#define AS_FIELD(t, n) \
-  t n;
-X_ELEMENTS(AS_FIELD)
-} header_t;
+static void *read_records(void *a) {
+  record_t *r;
+  (void) a;
+  for (;;) {
+    pthread_mutex_lock(&lock);
+    r = next_record < record_count ? &records[next_record++] : 0;
+    pthread_mutex_unlock(&lock);
+    if (!r)
+      break;
+    read_record(r);
+    pthread_mutex_lock(&lock);
+    r->done = 1;
+    pthread_cond_broadcast(&record_done);
+    pthread_mutex_unlock(&lock);
+  }
+  return 0;
+}
+
+static void wait_record(record_t *r) {
+  pthread_mutex_lock(&lock);
+  while (!r->done)
+    pthread_cond_wait(&record_done, &lock);
+  pthread_mutex_unlock(&lock);
+}
 
 #define FMT_uint32_t PRIu32
 #define FMT_uint8_t PRIu8
 #define FMT_float "f"
 #define FMT(x) FMT_##x
-#define UNUSED(n) (#n[0] == '_')
 
-static void print_header(uint8_t *d) {
+static void print_text_stats(const stats_t *s) {
+  const section_stats_t *a;
+  size_t i;
 
-#define AS_VARIABLE(t, n) \
-  t n;
-X_ELEMENTS(AS_VARIABLE)
+  printf("data_size = %" PRIu64 "\n", s->data_size);
+  for (i = 0; i < ELM_SECTIONS; i++) {
+    a = &s->sections[i];
+    printf("section %s = %" PRIu64 " x %" PRIu64 " at %" PRIu64 "\n",
+           elm_section_name(i), a->count, a->size, a->offset);
+  }
+  for (i = 0; i < 256; i++) {
+    if (s->terrain_types[i])
+      printf("terrain_type %lu = %" PRIu64 "\n", (unsigned long) i,
+             s->terrain_types[i]);
+  }
+  printf("walkable_tiles = %" PRIu64 "\n", s->walkable_tiles);
+  printf("bad_lights = %" PRIu64 "\n", s->bad_lights);
+  for (i = 0; i < s->mesh_names; i++)
+    printf("mesh %s = %" PRIu64 "\n", s->meshes[i].name,
+           s->meshes[i].count);
+  for (i = 0; i < s->problem_count; i++)
+    printf("problem = %s\n", s->problems[i]);
+}
 
-#define AS_EXTRACT(t, n) \
-  if (!UNUSED(n)) { \
-    n = extract_##t(d); \
-  } \
-  d += sizeof(t);
-X_ELEMENTS(AS_EXTRACT)
+static void print_text(const record_t *r) {
+  const elm_header_t *h = &r->header;
+
+  if (r->failed)
+    die("%s: %s", r->path, r->error);
 
 #define AS_PRINT(t, n) \
-  if (!UNUSED(n)) { \
-    printf(#n " = %" FMT(t) "\n", n); \
+  if (!ELM_UNUSED(n)) { \
+    printf(#n " = %" FMT(t) "\n", h->n); \
+  }
+ELM_HEADER_ELEMENTS(AS_PRINT)
+#undef AS_PRINT
+
+  if (show_stats)
+    print_text_stats(&r->stats);
+}
+
+static void print_csv_string(const char *s) {
+  if (!strpbrk(s, ",\"\r\n")) {
+    fputs(s, stdout);
+    return;
+  }
+  putchar('"');
+  for (; *s; s++) {
+    if (*s == '"')
+      putchar('"');
+    putchar(*s);
   }
-X_ELEMENTS(AS_PRINT)
+  putchar('"');
+}
+
+static void print_csv_names(void) {
+  printf("path");
+#define AS_NAME(t, n) \
+  if (!ELM_UNUSED(n)) \
+    printf("," #n);
+ELM_HEADER_ELEMENTS(AS_NAME)
+#undef AS_NAME
+  if (show_stats)
+    printf(",data_size,walkable_tiles,bad_lights,problems");
+  printf(",error\n");
+}
+
+static void print_csv_stats(const record_t *r) {
+  const stats_t *s = &r->stats;
+  char b[1024];
+  size_t i, n = 0;
 
+  if (r->failed) {
+    printf(",,,,");
+    return;
+  }
+  printf(",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",", s->data_size,
+         s->walkable_tiles, s->bad_lights);
+  b[0] = 0;
+  for (i = 0; i < s->problem_count && n < sizeof b; i++)
+    n += snprintf(b + n, sizeof b - n, "%s%s", i ? "; " : "",
+                  s->problems[i]);
+  print_csv_string(b);
+}
+
+static void print_csv(const record_t *r) {
+  const elm_header_t *h = &r->header;
+
+  print_csv_string(r->path);
+#define AS_PRINT(t, n) \
+  if (!ELM_UNUSED(n)) { \
+    if (r->failed) \
+      putchar(','); \
+    else \
+      printf(",%" FMT(t), h->n); \
+  }
+ELM_HEADER_ELEMENTS(AS_PRINT)
+#undef AS_PRINT
+  if (show_stats)
+    print_csv_stats(r);
+  putchar(',');
+  if (r->failed)
+    print_csv_string(r->error);
+  putchar('\n');
+}
+
+static void print_json_string(const char *s) {
+  putchar('"');
+  for (; *s; s++) {
+    if (*s == '"' || *s == '\\')
+      printf("\\%c", *s);
+    else if ((unsigned char) *s < 0x20)
+      printf("\\u%04x", *s);
+    else
+      putchar(*s);
+  }
+  putchar('"');
+}
+
+static void print_json_stats(const stats_t *s) {
+  const section_stats_t *a;
+  size_t i, n;
+
+  printf(", \"data_size\": %" PRIu64 ", \"sections\": {", s->data_size);
+  for (i = 0; i < ELM_SECTIONS; i++) {
+    a = &s->sections[i];
+    printf("%s\"%s\": {\"offset\": %" PRIu64 ", \"count\": %" PRIu64
+           ", \"size\": %" PRIu64 "}", i ? ", " : "", elm_section_name(i),
+           a->offset, a->count, a->size);
+  }
+  printf("}, \"terrain_types\": {");
+  for (i = n = 0; i < 256; i++) {
+    if (s->terrain_types[i])
+      printf("%s\"%lu\": %" PRIu64, n++ ? ", " : "", (unsigned long) i,
+             s->terrain_types[i]);
+  }
+  printf("}, \"walkable_tiles\": %" PRIu64 ", \"bad_lights\": %" PRIu64
+         ", \"meshes\": {", s->walkable_tiles, s->bad_lights);
+  for (i = 0; i < s->mesh_names; i++) {
+    if (i)
+      printf(", ");
+    print_json_string(s->meshes[i].name);
+    printf(": %" PRIu64, s->meshes[i].count);
+  }
+  printf("}, \"problems\": [");
+  for (i = 0; i < s->problem_count; i++) {
+    if (i)
+      printf(", ");
+    print_json_string(s->problems[i]);
+  }
+  printf("]");
+}
+
+static void print_json_uint32_t(uint32_t v) {
+  printf("%" PRIu32, v);
+}
+
+static void print_json_uint8_t(uint8_t v) {
+  printf("%" PRIu8, v);
+}
+
+/* JSON has no NaN or infinity, which a damaged header can hold. */
+static void print_json_float(float v) {
+  if (isfinite(v))
+    printf("%f", v);
+  else
+    printf("null");
+}
+
+static void print_json(const record_t *r, int last) {
+  const elm_header_t *h = &r->header;
+
+  printf("{\"path\": ");
+  print_json_string(r->path);
+  if (r->failed) {
+    printf(", \"error\": ");
+    print_json_string(r->error);
+  } else {
+#define AS_PRINT(t, n) \
+  if (!ELM_UNUSED(n)) { \
+    printf(", \"" #n "\": "); \
+    print_json_##t(h->n); \
+  }
+ELM_HEADER_ELEMENTS(AS_PRINT)
+#undef AS_PRINT
+    if (show_stats)
+      print_json_stats(&r->stats);
+  }
+  printf("}%s\n", last ? "" : ",");
 }
 
 int main(int argc, char **argv) {
-  uint8_t b[sizeof(header_t)];
-  int i;
+  pthread_t *t;
+  int format = TEXT, threads = 0, failed = 0;
+  int c, i, n;
+
+  while (-1 != (c = getopt(argc, argv, "hf:j:s"))) {
+    switch (c) {
+    case 'f':
+      if (!strcmp(optarg, "text"))
+        format = TEXT;
+      else if (!strcmp(optarg, "csv"))
+        format = CSV;
+      else if (!strcmp(optarg, "json"))
+        format = JSON;
+      else
+        die("unknown output format: %s", optarg);
+      break;
+    case 'j':
+      if ((threads = atoi(optarg)) < 1)
+        die("invalid thread count: %s", optarg);
+      break;
+    case 's':
+      show_stats = 1;
+      break;
+    case 'h':
+    default:
+      usage(argv[0]);
+    }
+  }
+  if (optind >= argc)
+    usage(argv[0]);
 
-  if (argc < 2) {
-    die("usage: %s map.elm.gz", argv[0]);
-    return 1;
+  n = record_count = argc - optind;
+  if (!(records = calloc(n, sizeof *records)))
+    die("out of memory");
+  for (i = 0; i < n; i++)
+    records[i].path = argv[optind + i];
+
+  if (!threads && (threads = sysconf(_SC_NPROCESSORS_ONLN)) < 1)
+    threads = 1;
+  if (threads > n)
+    threads = n;
+  if (!(t = calloc(threads, sizeof *t)))
+    die("out of memory");
+  for (i = 0; i < threads; i++) {
+    if ((errno = pthread_create(&t[i], 0, read_records, 0)))
+      die("pthread_create failed: %s", strerror(errno));
   }
-  for (i = 1; i < argc; i++) {
-    read_header(argv[i], b, sizeof b);
-    print_header(b);
+
+  if (format == CSV)
+    print_csv_names();
+  else if (format == JSON)
+    printf("[\n");
+  for (i = 0; i < n; i++) {
+    wait_record(&records[i]);
+    failed |= records[i].failed || records[i].stats.problem_count;
+    switch (format) {
+    case TEXT:
+      print_text(&records[i]);
+      break;
+    case CSV:
+      print_csv(&records[i]);
+      break;
+    case JSON:
+      print_json(&records[i], i == n - 1);
+      break;
+    }
+    stats_free(&records[i].stats);
   }
+  if (format == JSON)
+    printf("]\n");
 
-  return 0;
+  for (i = 0; i < threads; i++)
+    pthread_join(t[i], 0);
+  free(t);
+  free(records);
+
+  return failed;
 }
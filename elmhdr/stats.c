@@ -0,0 +1,242 @@
+/*
+ * elmhdr - Print ELM file header
+ * Copyright (C) 2014 Cole Minor
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#include "stats.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef struct {
+  stats_t *s;
+  /* lights outside these are bad, as in elm-remove-bad-lights.py */
+  float bounds[3][2];
+  int failed;
+} scan_t;
+
+static void add_problem(stats_t *s, const char *f, ...) {
+  char b[256], **p;
+  va_list a;
+  va_start(a, f);
+  vsnprintf(b, sizeof b, f, a);
+  va_end(a);
+  p = realloc(s->problems, (s->problem_count + 1) * sizeof *p);
+  if (!p || !(p[s->problem_count] = strdup(b))) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  s->problems = p;
+  s->problem_count++;
+}
+
+static uint32_t hash_name(const char *n) {
+  uint32_t h = 2166136261u;
+  for (; *n; n++)
+    h = (h ^ (uint8_t) *n) * 16777619u;
+  return h;
+}
+
+static mesh_count_t *find_mesh(stats_t *s, const char *n) {
+  size_t i = hash_name(n) & (s->mesh_slots - 1);
+  while (s->meshes[i].count && strcmp(s->meshes[i].name, n))
+    i = (i + 1) & (s->mesh_slots - 1);
+  return &s->meshes[i];
+}
+
+static void grow_meshes(stats_t *s) {
+  mesh_count_t *o = s->meshes, *m;
+  size_t i, n = s->mesh_slots;
+
+  s->mesh_slots = n ? 2 * n : 64;
+  if (!(s->meshes = calloc(s->mesh_slots, sizeof *s->meshes))) {
+    fprintf(stderr, "out of memory\n");
+    exit(1);
+  }
+  for (i = 0; i < n; i++) {
+    if (o[i].count) {
+      m = find_mesh(s, o[i].name);
+      *m = o[i];
+    }
+  }
+  free(o);
+}
+
+static void count_mesh(stats_t *s, const uint8_t *r) {
+  char n[MESH_NAME_SIZE + 1];
+  mesh_count_t *m;
+
+  memcpy(n, r, MESH_NAME_SIZE);
+  n[MESH_NAME_SIZE] = 0;
+  if (2 * (s->mesh_names + 1) > s->mesh_slots)
+    grow_meshes(s);
+  m = find_mesh(s, n);
+  if (!m->count++) {
+    memcpy(m->name, n, sizeof n);
+    s->mesh_names++;
+  }
+}
+
+static int bad_light(const scan_t *c, const uint8_t *r) {
+  float p, k;
+  int i;
+  for (i = 0; i < 3; i++) {
+    p = elm_float(r + 4 * i);
+    k = elm_float(r + 12 + 4 * i);
+    if (!(c->bounds[i][0] < p && p < c->bounds[i][1]))
+      return 1;
+    if (!(-1 < k && k < 1000))
+      return 1;
+  }
+  return 0;
+}
+
+static void scan_records(void *data, elm_section_id id, size_t first,
+                         const uint8_t *d, size_t count) {
+  scan_t *c = data;
+  stats_t *s = c->s;
+  size_t i, z = s->sections[id].size;
+
+  (void) first;
+  switch (id) {
+  case ELM_TERRAIN:
+    for (i = 0; i < count; i++)
+      s->terrain_types[d[i]]++;
+    break;
+  case ELM_TILES:
+    for (i = 0; i < count; i++)
+      s->walkable_tiles += d[i] != 0;
+    break;
+  case ELM_MESHES:
+    if (z == ELM_MESH_SIZE) {
+      for (i = 0; i < count; i++)
+        count_mesh(s, d + i * z);
+    }
+    break;
+  case ELM_LIGHTS:
+    if (z == ELM_LIGHT_SIZE) {
+      for (i = 0; i < count; i++)
+        s->bad_lights += bad_light(c, d + i * z);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+static int compare_meshes(const void *a, const void *b) {
+  const mesh_count_t *m = a, *n = b;
+  if (m->count != n->count)
+    return m->count < n->count ? 1 : -1;
+  return strcmp(m->name, n->name);
+}
+
+static void check_sections(stats_t *s) {
+  static const uint64_t record_sizes[ELM_SECTIONS] = {
+    1, 1, ELM_MESH_SIZE, ELM_QUAD_SIZE, ELM_LIGHT_SIZE, ELM_FUZZ_SIZE, 2
+  };
+  const section_stats_t *a, *b;
+  uint64_t e[ELM_SECTIONS], f;
+  int i, j;
+
+  for (i = 0; i < ELM_SECTIONS; i++) {
+    a = &s->sections[i];
+    e[i] = 0;
+    if (!a->count)
+      continue;
+    if (a->size != record_sizes[i])
+      add_problem(s, "%s records are %lu bytes, not %lu",
+                  elm_section_name(i), (unsigned long) a->size,
+                  (unsigned long) record_sizes[i]);
+    if (a->size && a->count > (UINT64_MAX - a->offset) / a->size) {
+      add_problem(s, "%s section size overflows", elm_section_name(i));
+      continue;
+    }
+    e[i] = a->offset + a->count * a->size;
+    if (a->offset < ELM_FILE_HEADER_SIZE)
+      add_problem(s, "%s section at %lu overlaps the header",
+                  elm_section_name(i), (unsigned long) a->offset);
+    if (e[i] > s->data_size)
+      add_problem(s, "%s section ends at %lu, past the end of the "
+                  "data at %lu", elm_section_name(i),
+                  (unsigned long) e[i], (unsigned long) s->data_size);
+  }
+
+  for (i = 0; i < ELM_SECTIONS; i++) {
+    a = &s->sections[i];
+    for (j = i + 1; j < ELM_SECTIONS; j++) {
+      b = &s->sections[j];
+      if (!e[i] || !e[j] || !a->size || !b->size)
+        continue;
+      f = a->offset > b->offset ? a->offset : b->offset;
+      if (f < e[i] && f < e[j])
+        add_problem(s, "%s and %s sections overlap at %lu",
+                    elm_section_name(i), elm_section_name(j),
+                    (unsigned long) f);
+    }
+  }
+}
+
+int stats_collect(elm_t *m, stats_t *s, char *e, size_t e_size) {
+  const elm_header_t *h = elm_header(m);
+  scan_t c;
+  size_t i, k;
+  int j;
+
+  memset(s, 0, sizeof *s);
+  for (j = 0; j < ELM_SECTIONS; j++) {
+    section_stats_t *a = &s->sections[j];
+    elm_section_extent(h, j, &a->offset, &a->count, &a->size);
+  }
+
+  memset(&c, 0, sizeof c);
+  c.s = s;
+  c.bounds[0][0] = c.bounds[1][0] = c.bounds[2][0] = -10;
+  c.bounds[0][1] = 3.0f * h->terrain_x + 10;
+  c.bounds[1][1] = 3.0f * h->terrain_y + 10;
+  c.bounds[2][1] = 100;
+  if (elm_scan(m, scan_records, &c, &s->data_size)) {
+    snprintf(e, e_size, "%s", elm_error(m));
+    stats_free(s);
+    return -1;
+  }
+
+  check_sections(s);
+  if (s->bad_lights)
+    add_problem(s, "%lu lights are out of bounds",
+                (unsigned long) s->bad_lights);
+
+  /* pack the used slots to the front, most used first */
+  for (i = k = 0; i < s->mesh_slots; i++) {
+    if (s->meshes[i].count)
+      s->meshes[k++] = s->meshes[i];
+  }
+  if (s->mesh_names)
+    qsort(s->meshes, s->mesh_names, sizeof *s->meshes, compare_meshes);
+
+  return 0;
+}
+
+void stats_free(stats_t *s) {
+  size_t i;
+  for (i = 0; i < s->problem_count; i++)
+    free(s->problems[i]);
+  free(s->problems);
+  free(s->meshes);
+  memset(s, 0, sizeof *s);
+}
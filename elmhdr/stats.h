@@ -0,0 +1,58 @@
+/*
+ * elmhdr - Print ELM file header
+ * Copyright (C) 2014 Cole Minor
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef ELMHDR_STATS_H
+#define ELMHDR_STATS_H
+
+#include "elm.h"
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* bytes of a mesh name in a mesh record */
+#define MESH_NAME_SIZE 80
+
+typedef struct {
+  char name[MESH_NAME_SIZE + 1];
+  uint64_t count;
+} mesh_count_t;
+
+typedef struct {
+  uint64_t offset, count, size;
+} section_stats_t;
+
+typedef struct {
+  uint64_t data_size;
+  section_stats_t sections[ELM_SECTIONS];
+  uint64_t terrain_types[256];
+  uint64_t walkable_tiles;
+  uint64_t bad_lights;
+  /* hash table of meshes by name, then sorted by count */
+  mesh_count_t *meshes;
+  size_t mesh_names;
+  size_t mesh_slots;
+  char **problems;
+  size_t problem_count;
+} stats_t;
+
+/* Reads the map once, filling in s. Returns 0, or -1 with a message
+ * in e if the map data cannot be read. */
+int stats_collect(elm_t *m, stats_t *s, char *e, size_t e_size);
+void stats_free(stats_t *s);
+
+#endif /* ELMHDR_STATS_H */
@@ -0,0 +1,712 @@
+/*
+ *  Copyright (C) 2014 Cole Minor
+ *  This file is part of libelm.
+ *
+ *  libelm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  libelm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#define _XOPEN_SOURCE 700
+
+#include "elm.h"
+
+#include <zlib.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* deflate never shrinks data by more than this */
+#define MAX_DEFLATE_RATIO 1032
+
+/* bytes inflated at a time by elm_scan */
+#define SCAN_WINDOW 65536
+
+/* A gzip map gets a seek index next to it, "map.elm.gz.idx", with an
+ * inflate checkpoint every INDEX_SPAN bytes of map data, so sections
+ * far into the map can be inflated without everything before them.
+ * The index is built the first time a section is read, and is thrown
+ * away when the map file changes size or modification time. */
+#define INDEX_SPAN (1 << 20)
+#define INDEX_WINDOW 32768
+#define INDEX_VERSION 2
+
+typedef struct {
+  char magic[4];
+  uint32_t version;    /* byte swapped on a host of other endianness */
+  uint64_t file_size;
+  int64_t file_mtime;
+  int64_t file_mtime_nsec;
+  uint64_t data_size;  /* map data covered */
+  uint64_t count;
+} index_header_t;
+
+typedef struct {
+  uint64_t out;        /* offset in the map data */
+  uint64_t in;         /* offset of the next byte in the gzip file */
+  uint32_t bits;       /* bits of the byte before it still to read */
+  uint32_t window_size;
+  uint8_t *window;     /* map data just before out */
+} index_point_t;
+
+struct elm {
+  int fd;
+  elm_header_t header;
+  /* the whole file when mapped, or the inflated part of it so far */
+  const uint8_t *data;
+  size_t size;
+  size_t ready;
+  void *map;
+  /* gzip files are inflated into a buffer on demand */
+  uint8_t *buffer;
+  z_stream z;
+  int inflating;
+  uint64_t in_total;
+  uint8_t in[16384];
+  /* seek index of a gzip file */
+  struct stat st;
+  char *index_path;
+  index_point_t *points;
+  size_t point_count;
+  int indexing;
+  int loaded[ELM_SECTIONS];
+  char error[256];
+};
+
+static const char *section_names[ELM_SECTIONS] = {
+  "terrain", "tiles", "meshes", "quads", "lights", "fuzz", "segments"
+};
+
+static void set_error(elm_t *m, const char *f, ...) {
+  va_list a;
+  va_start(a, f);
+  vsnprintf(m->error, sizeof m->error, f, a);
+  va_end(a);
+}
+
+static void free_points(elm_t *m) {
+  size_t i;
+  for (i = 0; i < m->point_count; i++)
+    free(m->points[i].window);
+  free(m->points);
+  m->points = 0;
+  m->point_count = 0;
+}
+
+/* Records a checkpoint at a block boundary the stream has just
+ * reached, if it is far enough past the last one. */
+static void add_point(elm_t *m) {
+  index_point_t *p;
+  uint64_t o = m->ready;
+  size_t w = o < INDEX_WINDOW ? o : INDEX_WINDOW;
+
+  if (m->point_count && o - m->points[m->point_count - 1].out < INDEX_SPAN)
+    return;
+  p = realloc(m->points, (m->point_count + 1) * sizeof *p);
+  if (!p) {
+    m->indexing = 0;
+    return;
+  }
+  m->points = p;
+  p += m->point_count;
+  if (!(p->window = malloc(w ? w : 1))) {
+    m->indexing = 0;
+    return;
+  }
+  p->out = o;
+  p->in = m->in_total - m->z.avail_in;
+  p->bits = m->z.data_type & 7;
+  p->window_size = w;
+  memcpy(p->window, m->buffer + o - w, w);
+  m->point_count++;
+}
+
+/* Writes the index through a temporary file, so a reader never sees
+ * half of one. Failing to is not an error; the map still reads. */
+static void save_index(elm_t *m) {
+  index_header_t h;
+  char *t;
+  FILE *f;
+  size_t i;
+  int ok;
+
+  if (!(t = malloc(strlen(m->index_path) + 48)))
+    return;
+  sprintf(t, "%s.%ld.%lx", m->index_path, (long) getpid(),
+          (unsigned long) (uintptr_t) m);
+  if (!(f = fopen(t, "wb"))) {
+    free(t);
+    return;
+  }
+  memset(&h, 0, sizeof h);
+  memcpy(h.magic, "elmi", 4);
+  h.version = INDEX_VERSION;
+  h.file_size = m->st.st_size;
+  h.file_mtime = m->st.st_mtime;
+  h.file_mtime_nsec = m->st.st_mtim.tv_nsec;
+  h.data_size = m->size;
+  h.count = m->point_count;
+  ok = fwrite(&h, sizeof h, 1, f) == 1;
+  for (i = 0; ok && i < m->point_count; i++) {
+    const index_point_t *p = &m->points[i];
+    ok = fwrite(p, offsetof(index_point_t, window), 1, f) == 1
+      && fwrite(p->window, 1, p->window_size, f) == p->window_size;
+  }
+  if (fclose(f))
+    ok = 0;
+  if (!ok || rename(t, m->index_path))
+    unlink(t);
+  free(t);
+}
+
+/* Loads the index if it is there and still matches the map. */
+static int load_index(elm_t *m) {
+  index_header_t h;
+  index_point_t *p;
+  FILE *f;
+  size_t i;
+  int ok;
+
+  if (!(f = fopen(m->index_path, "rb")))
+    return -1;
+  ok = fread(&h, sizeof h, 1, f) == 1
+    && !memcmp(h.magic, "elmi", 4)
+    && h.version == INDEX_VERSION
+    && h.file_size == (uint64_t) m->st.st_size
+    && h.file_mtime == (int64_t) m->st.st_mtime
+    && h.file_mtime_nsec == (int64_t) m->st.st_mtim.tv_nsec
+    && h.data_size == m->size
+    && h.count && h.count <= m->size / INDEX_SPAN + 1
+    && (m->points = calloc(h.count, sizeof *m->points));
+  for (i = 0; ok && i < h.count; i++) {
+    p = &m->points[i];
+    ok = fread(p, offsetof(index_point_t, window), 1, f) == 1
+      && p->window_size <= INDEX_WINDOW && p->window_size <= p->out
+      && p->bits < 8 && p->out <= m->size
+      && (!i || p->out > p[-1].out)
+      && (p->window = malloc(p->window_size ? p->window_size : 1));
+    if (ok) {
+      m->point_count++;
+      ok = fread(p->window, 1, p->window_size, f) == p->window_size;
+    }
+  }
+  fclose(f);
+  if (!ok) {
+    free_points(m);
+    return -1;
+  }
+  return 0;
+}
+
+/* Inflates map data from a checkpoint up to end, straight into its
+ * place in the buffer, leaving the sequential stream as it is. */
+static int inflate_from(elm_t *m, const index_point_t *p, size_t end) {
+  uint8_t in[16384];
+  z_stream z;
+  off_t o = p->in;
+  ssize_t r;
+  int e = Z_OK;
+
+  memset(&z, 0, sizeof z);
+  if (inflateInit2(&z, -15) != Z_OK)
+    return -1;
+  if (p->bits) {
+    if (pread(m->fd, in, 1, --o) != 1)
+      goto fail;
+    o++;
+    inflatePrime(&z, p->bits, in[0] >> (8 - p->bits));
+  }
+  if (p->window_size
+      && inflateSetDictionary(&z, p->window, p->window_size) != Z_OK)
+    goto fail;
+  z.next_out = m->buffer + p->out;
+  z.avail_out = end - p->out;
+  while (z.avail_out) {
+    if (!z.avail_in) {
+      if ((r = pread(m->fd, in, sizeof in, o)) <= 0)
+        goto fail;
+      o += r;
+      z.next_in = in;
+      z.avail_in = r;
+    }
+    e = inflate(&z, Z_NO_FLUSH);
+    if (e != Z_OK && (e != Z_STREAM_END || z.avail_out))
+      goto fail;
+  }
+  inflateEnd(&z);
+  return 0;
+
+fail:
+  inflateEnd(&z);
+  return -1;
+}
+
+/* Inflates until at least n bytes are ready. */
+static int inflate_to(elm_t *m, size_t n) {
+  z_stream *z = &m->z;
+  ssize_t r;
+  int e;
+
+  if (n > m->size) {
+    set_error(m, "map data ends at %lu bytes, before %lu",
+              (unsigned long) m->size, (unsigned long) n);
+    return -1;
+  }
+  while (m->ready < n) {
+    if (!z->avail_in) {
+      r = read(m->fd, m->in, sizeof m->in);
+      if (r > 0)
+        m->in_total += r;
+      if (r < 0) {
+        set_error(m, "read failed: %s", strerror(errno));
+        return -1;
+      }
+      if (!r) {
+        set_error(m, "map data ends at %lu bytes, before %lu",
+                  (unsigned long) m->ready, (unsigned long) n);
+        return -1;
+      }
+      z->next_in = m->in;
+      z->avail_in = r;
+    }
+    z->next_out = m->buffer + m->ready;
+    z->avail_out = m->size - m->ready;
+    e = inflate(z, m->indexing ? Z_BLOCK : Z_NO_FLUSH);
+    m->ready = m->size - z->avail_out;
+    if (m->indexing && m->ready < m->size
+        && (z->data_type & 128) && !(z->data_type & 64))
+      add_point(m);
+    if (e == Z_STREAM_END) {
+      /* Another gzip member may follow, and checkpoints cannot see
+       * past the end of one. */
+      if (m->ready < m->size) {
+        m->indexing = 0;
+        free_points(m);
+      }
+      if (inflateReset(z) != Z_OK) {
+        set_error(m, "inflateReset failed");
+        return -1;
+      }
+    } else if (e != Z_OK && e != Z_BUF_ERROR) {
+      set_error(m, "inflate failed: %s", z->msg ? z->msg : "error");
+      return -1;
+    }
+  }
+  if (m->indexing && m->ready == m->size) {
+    m->indexing = 0;
+    save_index(m);
+  }
+  return 0;
+}
+
+/* Makes bytes o to n of the map, section s, available. */
+static int need(elm_t *m, elm_section_id s, size_t o, size_t n) {
+  const index_point_t *p = 0;
+  size_t i;
+
+  if (m->buffer) {
+    if (m->ready >= n || m->loaded[s])
+      return 0;
+    /* The index is built in one go, as far as any section reaches.
+     * If the data ends early or is damaged, it is read on without
+     * one, and fails below if this section cannot be had. */
+    if (m->indexing && inflate_to(m, m->size)) {
+      m->indexing = 0;
+      free_points(m);
+    }
+    for (i = 0; i < m->point_count && m->points[i].out <= o; i++)
+      p = &m->points[i];
+    if (p && p->out > m->ready && !inflate_from(m, p, n)) {
+      m->loaded[s] = 1;
+      return 0;
+    }
+    return inflate_to(m, n);
+  }
+  if (n > m->size) {
+    set_error(m, "map file ends at %lu bytes, before %lu",
+              (unsigned long) m->size, (unsigned long) n);
+    return -1;
+  }
+  return 0;
+}
+
+void elm_section_extent(const elm_header_t *h, elm_section_id s,
+                        uint64_t *offset, uint64_t *count,
+                        uint64_t *size) {
+  uint64_t t = (uint64_t) h->terrain_x * h->terrain_y;
+  if (t > UINT64_MAX / 36)
+    t = UINT64_MAX / 36;
+  switch (s) {
+  case ELM_TERRAIN:
+    *offset = h->terrain_offset; *count = t; *size = 1;
+    break;
+  case ELM_TILES:
+    *offset = h->tile_offset; *count = 36 * t; *size = 1;
+    break;
+  case ELM_MESHES:
+    *offset = h->mesh_offset; *count = h->mesh_count; *size = h->mesh_size;
+    break;
+  case ELM_QUADS:
+    *offset = h->quad_offset; *count = h->quad_count; *size = h->quad_size;
+    break;
+  case ELM_LIGHTS:
+    *offset = h->light_offset; *count = h->light_count;
+    *size = h->light_size;
+    break;
+  case ELM_FUZZ:
+    *offset = h->fuzz_offset; *count = h->fuzz_count; *size = h->fuzz_size;
+    break;
+  case ELM_SEGMENTS:
+    *offset = h->segment_offset;
+    *count = h->segment_offset ? 36 * t : 0;
+    *size = 2;
+    break;
+  default:
+    *offset = *count = *size = 0;
+  }
+}
+
+/* Gets the offset just past a section, or -1 if it overflows. */
+static int section_end(const elm_header_t *h, elm_section_id s,
+                       uint64_t *end) {
+  uint64_t o, c, z;
+  elm_section_extent(h, s, &o, &c, &z);
+  if (c && z > (UINT64_MAX - o) / c)
+    return -1;
+  *end = c ? o + c * z : 0;
+  return 0;
+}
+
+static void read_header(elm_t *m) {
+  const uint8_t *d = m->data;
+#define AS_EXTRACT(t, n) \
+  if (!ELM_UNUSED(n)) \
+    m->header.n = elm_##t(d); \
+  d += sizeof(t);
+  ELM_HEADER_ELEMENTS(AS_EXTRACT)
+#undef AS_EXTRACT
+}
+
+static int open_gzip(elm_t *m, const char *path, off_t file_size) {
+  uint64_t e, l;
+  uint8_t *b;
+  int i;
+
+  m->z.next_in = m->in;
+  m->z.avail_in = 0;
+  if (inflateInit2(&m->z, 15 + 16) != Z_OK) {
+    set_error(m, "inflateInit2 failed");
+    return -1;
+  }
+  m->inflating = 1;
+
+  m->size = ELM_HEADER_SIZE;
+  if (!(m->buffer = malloc(m->size))) {
+    set_error(m, "out of memory");
+    return -1;
+  }
+  m->data = m->buffer;
+  if (inflate_to(m, ELM_HEADER_SIZE))
+    return -1;
+  if (memcmp("elmf", m->data, 4)) {
+    set_error(m, "map file signature not found");
+    return -1;
+  }
+  read_header(m);
+
+  /* Size the buffer once for every section, so views given out
+   * earlier never move. Sections that cannot fit in the file are
+   * left out, and fail when asked for. */
+  l = ELM_HEADER_SIZE;
+  for (i = 0; i < ELM_SECTIONS; i++) {
+    if (section_end(&m->header, i, &e) || e != (size_t) e
+        || e > (uint64_t) file_size * MAX_DEFLATE_RATIO)
+      continue;
+    if (e > l)
+      l = e;
+  }
+  if (!(b = realloc(m->buffer, l))) {
+    set_error(m, "out of memory");
+    return -1;
+  }
+  m->data = m->buffer = b;
+  m->size = l;
+
+  if (!(m->index_path = malloc(strlen(path) + 5))) {
+    set_error(m, "out of memory");
+    return -1;
+  }
+  sprintf(m->index_path, "%s.idx", path);
+  if (load_index(m))
+    m->indexing = 1;
+  return 0;
+}
+
+static int open_mapped(elm_t *m, off_t file_size) {
+  m->size = file_size;
+  if (file_size < ELM_HEADER_SIZE) {
+    set_error(m, "map header is incomplete");
+    return -1;
+  }
+  m->map = mmap(0, m->size, PROT_READ, MAP_PRIVATE, m->fd, 0);
+  if (m->map == MAP_FAILED) {
+    m->map = 0;
+    set_error(m, "mmap failed: %s", strerror(errno));
+    return -1;
+  }
+  m->data = m->map;
+  m->ready = m->size;
+  if (memcmp("elmf", m->data, 4)) {
+    set_error(m, "map file signature not found");
+    return -1;
+  }
+  read_header(m);
+  return 0;
+}
+
+elm_t *elm_open(const char *path, char *error, size_t error_size) {
+  uint8_t magic[2];
+  elm_t *m;
+  int r;
+
+  if (!(m = calloc(1, sizeof *m))) {
+    if (error)
+      snprintf(error, error_size, "out of memory");
+    return 0;
+  }
+  if ((m->fd = open(path, O_RDONLY)) == -1) {
+    set_error(m, "open failed: %s", strerror(errno));
+  } else if (fstat(m->fd, &m->st) == -1) {
+    set_error(m, "fstat failed: %s", strerror(errno));
+  } else if ((r = pread(m->fd, magic, 2, 0)) != 2) {
+    set_error(m, "map header is incomplete");
+  } else if (magic[0] == 0x1f && magic[1] == 0x8b) {
+    if (!open_gzip(m, path, m->st.st_size))
+      return m;
+  } else if (!open_mapped(m, m->st.st_size)) {
+    close(m->fd);
+    m->fd = -1;
+    return m;
+  }
+
+  if (error)
+    snprintf(error, error_size, "%s", m->error);
+  elm_close(m);
+  return 0;
+}
+
+void elm_close(elm_t *m) {
+  if (!m)
+    return;
+  if (m->inflating)
+    inflateEnd(&m->z);
+  if (m->map)
+    munmap(m->map, m->size);
+  if (m->fd != -1)
+    close(m->fd);
+  free(m->buffer);
+  free(m->index_path);
+  free_points(m);
+  free(m);
+}
+
+const elm_header_t *elm_header(const elm_t *m) {
+  return &m->header;
+}
+
+int elm_section(elm_t *m, elm_section_id s, elm_section_t *v) {
+  uint64_t o, c, z, e;
+
+  if (s < 0 || s >= ELM_SECTIONS) {
+    set_error(m, "unknown section %d", s);
+    return -1;
+  }
+  elm_section_extent(&m->header, s, &o, &c, &z);
+  v->data = 0;
+  v->count = c;
+  v->size = z;
+  if (!c)
+    return 0;
+  if (section_end(&m->header, s, &e) || e > m->size) {
+    set_error(m, "%s section at %lu reaches past the end of the map",
+              section_names[s], (unsigned long) o);
+    return -1;
+  }
+  if (need(m, s, o, e))
+    return -1;
+  v->data = m->data + o;
+  return 0;
+}
+
+typedef struct {
+  uint64_t offset, end, size;
+  size_t next;      /* index of the next record to pass on */
+  uint8_t *carry;   /* start of a record split between windows */
+  size_t carried;
+} scan_section_t;
+
+/* Passes on the part of data, which starts at offset o, that falls
+ * in section s. */
+static void scan_window(scan_section_t *c, elm_section_id s,
+                        uint64_t o, const uint8_t *d, size_t n,
+                        elm_scan_fn f, void *data) {
+  uint64_t a = o > c->offset ? o : c->offset;
+  uint64_t b = o + n < c->end ? o + n : c->end;
+  size_t k, r;
+
+  if (a >= b)
+    return;
+  d += a - o;
+  n = b - a;
+  if (c->carried) {
+    r = c->size - c->carried;
+    if (r > n)
+      r = n;
+    memcpy(c->carry + c->carried, d, r);
+    c->carried += r;
+    d += r;
+    n -= r;
+    if (c->carried < c->size)
+      return;
+    f(data, s, c->next++, c->carry, 1);
+    c->carried = 0;
+  }
+  if ((k = n / c->size)) {
+    f(data, s, c->next, d, k);
+    c->next += k;
+  }
+  if ((r = n - k * c->size)) {
+    memcpy(c->carry, d + k * c->size, r);
+    c->carried = r;
+  }
+}
+
+static int scan_gzip(elm_t *m, scan_section_t *c, elm_scan_fn f,
+                     void *data, uint64_t *size) {
+  uint8_t in[16384], *w;
+  z_stream z;
+  uint64_t o = 0;
+  off_t p = 0;
+  ssize_t r;
+  size_t n;
+  int e = Z_OK, i, result = -1;
+
+  if (!(w = malloc(SCAN_WINDOW))) {
+    set_error(m, "out of memory");
+    return -1;
+  }
+  memset(&z, 0, sizeof z);
+  if (inflateInit2(&z, 15 + 16) != Z_OK) {
+    set_error(m, "inflateInit2 failed");
+    free(w);
+    return -1;
+  }
+  for (;;) {
+    if (!z.avail_in) {
+      if ((r = pread(m->fd, in, sizeof in, p)) < 0) {
+        set_error(m, "read failed: %s", strerror(errno));
+        break;
+      }
+      if (!r) {
+        if (e != Z_STREAM_END) {
+          set_error(m, "map data is truncated at %lu bytes",
+                    (unsigned long) o);
+          break;
+        }
+        *size = o;
+        result = 0;
+        break;
+      }
+      p += r;
+      z.next_in = in;
+      z.avail_in = r;
+    }
+    if (e == Z_STREAM_END && inflateReset(&z) != Z_OK) {
+      set_error(m, "inflateReset failed");
+      break;
+    }
+    z.next_out = w;
+    z.avail_out = SCAN_WINDOW;
+    e = inflate(&z, Z_NO_FLUSH);
+    if (e != Z_OK && e != Z_STREAM_END && e != Z_BUF_ERROR) {
+      set_error(m, "inflate failed: %s", z.msg ? z.msg : "error");
+      break;
+    }
+    n = SCAN_WINDOW - z.avail_out;
+    for (i = 0; i < ELM_SECTIONS; i++) {
+      if (c[i].size)
+        scan_window(&c[i], i, o, w, n, f, data);
+    }
+    o += n;
+  }
+  inflateEnd(&z);
+  free(w);
+  return result;
+}
+
+int elm_scan(elm_t *m, elm_scan_fn f, void *data, uint64_t *size) {
+  scan_section_t c[ELM_SECTIONS];
+  uint64_t n;
+  int i, r = 0;
+
+  memset(c, 0, sizeof c);
+  for (i = 0; i < ELM_SECTIONS; i++) {
+    elm_section_extent(&m->header, i, &c[i].offset, &n, &c[i].size);
+    if (!n || !c[i].size || c[i].size > ELM_SCAN_MAX_RECORD
+        || section_end(&m->header, i, &c[i].end)) {
+      c[i].size = 0;
+      continue;
+    }
+    if (m->map) {
+      if (c[i].offset >= m->size)
+        c[i].size = 0;
+      else if (c[i].end > m->size)
+        c[i].end = c[i].offset + (m->size - c[i].offset) / c[i].size
+                                 * c[i].size;
+    } else if (c[i].size > 1 && !(c[i].carry = malloc(c[i].size))) {
+      set_error(m, "out of memory");
+      r = -1;
+      goto out;
+    }
+  }
+
+  if (m->map) {
+    /* the whole map is one window */
+    for (i = 0; i < ELM_SECTIONS; i++) {
+      if (c[i].size)
+        scan_window(&c[i], i, 0, m->data, m->size, f, data);
+    }
+    *size = m->size;
+  } else {
+    r = scan_gzip(m, c, f, data, size);
+  }
+
+out:
+  for (i = 0; i < ELM_SECTIONS; i++)
+    free(c[i].carry);
+  return r;
+}
+
+const char *elm_error(const elm_t *m) {
+  return m->error;
+}
+
+const char *elm_section_name(elm_section_id s) {
+  return s >= 0 && s < ELM_SECTIONS ? section_names[s] : "unknown";
+}
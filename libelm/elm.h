@@ -0,0 +1,172 @@
+/*
+ *  Copyright (C) 2014 Cole Minor
+ *  This file is part of libelm.
+ *
+ *  libelm is free software: you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation, either version 3 of the License, or
+ *  (at your option) any later version.
+ *
+ *  libelm is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ */
+#ifndef LIBELM_ELM_H
+#define LIBELM_ELM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* type, name */
+#define ELM_HEADER_ELEMENTS(X) \
+  X(uint32_t, _signature) \
+  X(uint32_t, terrain_x) \
+  X(uint32_t, terrain_y) \
+  X(uint32_t, terrain_offset) \
+  X(uint32_t, tile_offset) \
+  X(uint32_t, mesh_size) \
+  X(uint32_t, mesh_count) \
+  X(uint32_t, mesh_offset) \
+  X(uint32_t, quad_size) \
+  X(uint32_t, quad_count) \
+  X(uint32_t, quad_offset) \
+  X(uint32_t, light_size) \
+  X(uint32_t, light_count) \
+  X(uint32_t, light_offset) \
+  X(uint8_t, internal) \
+  X(uint8_t, version) \
+  X(uint8_t, _unused1) \
+  X(uint8_t, _unused2) \
+  X(float, ambient_red) \
+  X(float, ambient_green) \
+  X(float, ambient_blue) \
+  X(uint32_t, fuzz_size) \
+  X(uint32_t, fuzz_count) \
+  X(uint32_t, fuzz_offset) \
+  X(uint32_t, segment_offset)
+
+#define ELM_UNUSED(n) (#n[0] == '_')
+
+typedef struct {
+#define ELM_AS_FIELD(t, n) t n;
+  ELM_HEADER_ELEMENTS(ELM_AS_FIELD)
+#undef ELM_AS_FIELD
+} elm_header_t;
+
+/* bytes of header fields at the start of a map file */
+#define ELM_AS_SIZE(t, n) + sizeof(t)
+enum { ELM_HEADER_SIZE = 0 ELM_HEADER_ELEMENTS(ELM_AS_SIZE) };
+#undef ELM_AS_SIZE
+
+/* record sizes of the object sections */
+enum {
+  ELM_FILE_HEADER_SIZE = 124,   /* header fields and reserved space */
+  ELM_MESH_SIZE = 144,
+  ELM_QUAD_SIZE = 128,
+  ELM_LIGHT_SIZE = 40,
+  ELM_FUZZ_SIZE = 104
+};
+
+typedef enum {
+  ELM_TERRAIN,   /* terrain tile map, one byte per terrain tile */
+  ELM_TILES,     /* height map, one byte per 6x6 tiles of a terrain tile */
+  ELM_MESHES,
+  ELM_QUADS,
+  ELM_LIGHTS,
+  ELM_FUZZ,
+  ELM_SEGMENTS,  /* one 16-bit value per tile, may be absent */
+  ELM_SECTIONS
+} elm_section_id;
+
+/* A view of a section of a map. The data stays valid until the map
+ * is closed. */
+typedef struct {
+  const uint8_t *data;
+  size_t count;
+  size_t size;   /* bytes per record */
+} elm_section_t;
+
+typedef struct elm elm_t;
+
+/* Opens a map file, gzip compressed or not. On failure returns null
+ * and writes a message to the error buffer, if given. */
+elm_t *elm_open(const char *path, char *error, size_t error_size);
+void elm_close(elm_t *m);
+
+const elm_header_t *elm_header(const elm_t *m);
+
+/* Gets a view of a section, returning 0, or -1 on failure. */
+int elm_section(elm_t *m, elm_section_id s, elm_section_t *v);
+
+/* Gets where a section is in the map data according to a header. */
+void elm_section_extent(const elm_header_t *h, elm_section_id s,
+                        uint64_t *offset, uint64_t *count,
+                        uint64_t *size);
+
+/* Called by elm_scan with count whole records of a section, starting
+ * at record first. */
+typedef void (*elm_scan_fn)(void *data, elm_section_id s, size_t first,
+                            const uint8_t *records, size_t count);
+
+/* Reads the map data once from the start, passing each section to f
+ * as it goes, and sets size to the length of the data. A gzip
+ * compressed map is inflated through a small window instead of into
+ * memory. Records past the end of the data are left out, and so are
+ * sections with records over ELM_SCAN_MAX_RECORD bytes. Returns 0,
+ * or -1 on failure. */
+enum { ELM_SCAN_MAX_RECORD = 65536 };
+int elm_scan(elm_t *m, elm_scan_fn f, void *data, uint64_t *size);
+
+/* message for the last failure on an open map */
+const char *elm_error(const elm_t *m);
+const char *elm_section_name(elm_section_id s);
+
+/* Little endian readers for the fields of map records. */
+static inline int elm_big_endian(void) {
+  const union {
+    uint32_t i;
+    uint8_t b[4];
+  } u = { 0x01020304 };
+  return u.b[0] == 1;
+}
+
+static inline uint8_t elm_uint8_t(const uint8_t *b) {
+  return *b;
+}
+
+static inline uint16_t elm_uint16_t(const uint8_t *b) {
+  uint16_t v;
+  memcpy(&v, b, sizeof v);
+  return elm_big_endian() ? __builtin_bswap16(v) : v;
+}
+
+static inline uint32_t elm_uint32_t(const uint8_t *b) {
+  uint32_t v;
+  memcpy(&v, b, sizeof v);
+  return elm_big_endian() ? __builtin_bswap32(v) : v;
+}
+
+static inline float elm_float(const uint8_t *b) {
+  union {
+    uint32_t i;
+    float f;
+  } u;
+  u.i = elm_uint32_t(b);
+  return u.f;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* LIBELM_ELM_H */
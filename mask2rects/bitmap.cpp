@@ -0,0 +1,171 @@
+//
+// Copyright 2013 Cole Minor <c.minor@inbox.com>
+//
+//    This file is part of mask2rects.
+//
+//    mask2rects is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    mask2rects is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with mask2rects.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "bitmap.hpp"
+
+static inline uint64_t mask_from(int x) {
+  return ~0ULL << (x & 63);
+}
+
+static inline uint64_t mask_to(int x) {
+  return ~0ULL >> (63 - (x & 63));
+}
+
+Bitmap::Bitmap()
+  :m_width(0), m_height(0), m_stride(0), m_words() {
+}
+
+Bitmap::Bitmap(int w, int h)
+  :m_width(w), m_height(h), m_stride((w + 63) >> 6),
+   m_words(m_stride * h, 0) {
+}
+
+void Bitmap::resize(int w, int h) {
+  m_width = w;
+  m_height = h;
+  m_stride = (w + 63) >> 6;
+  m_words.assign(m_stride * h, 0);
+}
+
+// sets or clears x0..x1 inclusive on row y
+void Bitmap::fill(int y, int x0, int x1, bool v) {
+  uint64_t *r = row(y);
+  int w0 = x0 >> 6, w1 = x1 >> 6;
+  uint64_t m0 = mask_from(x0), m1 = mask_to(x1);
+  if (w0 == w1)
+    m0 = m1 = m0 & m1;
+  if (v) {
+    r[w0] |= m0;
+    for (int i = w0 + 1; i < w1; ++i)
+      r[i] = ~0ULL;
+    r[w1] |= m1;
+  } else {
+    r[w0] &= ~m0;
+    for (int i = w0 + 1; i < w1; ++i)
+      r[i] = 0;
+    r[w1] &= ~m1;
+  }
+}
+
+// whether x0..x1 on row y are all set
+bool Bitmap::all(int y, int x0, int x1) const {
+  const uint64_t *r = row(y);
+  int w0 = x0 >> 6, w1 = x1 >> 6;
+  uint64_t m0 = mask_from(x0), m1 = mask_to(x1);
+  if (w0 == w1)
+    return (r[w0] & (m0 & m1)) == (m0 & m1);
+  if ((r[w0] & m0) != m0 || (r[w1] & m1) != m1)
+    return false;
+  for (int i = w0 + 1; i < w1; ++i) {
+    if (r[i] != ~0ULL)
+      return false;
+  }
+  return true;
+}
+
+// whether y0..y1 in column x are all set
+bool Bitmap::all_column(int x, int y0, int y1) const {
+  const uint64_t *w = &m_words[(x >> 6) + y0 * m_stride];
+  uint64_t m = 1ULL << (x & 63);
+  for (int y = y0; y <= y1; ++y, w += m_stride) {
+    if (!(*w & m))
+      return false;
+  }
+  return true;
+}
+
+// whether x0..x1 on row y match the same points of o, which must
+// be the same width
+bool Bitmap::same(const Bitmap &o, int y, int x0, int x1) const {
+  const uint64_t *r = row(y), *s = o.row(y);
+  int w0 = x0 >> 6, w1 = x1 >> 6;
+  uint64_t m0 = mask_from(x0), m1 = mask_to(x1);
+  if (w0 == w1)
+    return !((r[w0] ^ s[w0]) & (m0 & m1));
+  if (((r[w0] ^ s[w0]) & m0) || ((r[w1] ^ s[w1]) & m1))
+    return false;
+  for (int i = w0 + 1; i < w1; ++i) {
+    if (r[i] != s[i])
+      return false;
+  }
+  return true;
+}
+
+// first set point at or after x on row y, or the width if none
+int Bitmap::next_set(int x, int y) const {
+  if (x >= m_width)
+    return m_width;
+  const uint64_t *r = row(y);
+  int i = x >> 6;
+  uint64_t w = r[i] & mask_from(x);
+  while (!w) {
+    if (++i == m_stride)
+      return m_width;
+    w = r[i];
+  }
+  return (i << 6) + __builtin_ctzll(w);
+}
+
+// first clear point at or after x on row y, or the width if none
+int Bitmap::next_clear(int x, int y) const {
+  if (x >= m_width)
+    return m_width;
+  const uint64_t *r = row(y);
+  int i = x >> 6;
+  uint64_t w = ~r[i] & mask_from(x);
+  while (!w) {
+    if (++i == m_stride)
+      return m_width;
+    w = ~r[i];
+  }
+  int c = (i << 6) + __builtin_ctzll(w);
+  return c < m_width ? c : m_width;
+}
+
+size_t Bitmap::count() const {
+  size_t n = 0;
+  for (size_t i = 0; i < m_words.size(); ++i)
+    n += __builtin_popcountll(m_words[i]);
+  return n;
+}
+
+// set points on row y
+size_t Bitmap::count(int y) const {
+  const uint64_t *r = row(y);
+  size_t n = 0;
+  for (int i = 0; i < m_stride; ++i)
+    n += __builtin_popcountll(r[i]);
+  return n;
+}
+
+// the set point on row y with k set points before it, or the width
+// if there are not that many
+int Bitmap::select(int y, size_t k) const {
+  const uint64_t *r = row(y);
+  for (int i = 0; i < m_stride; ++i) {
+    uint64_t w = r[i];
+    size_t n = __builtin_popcountll(w);
+    if (k < n) {
+      while (k--)
+        w &= w - 1;
+      return (i << 6) + __builtin_ctzll(w);
+    }
+    k -= n;
+  }
+  return m_width;
+}
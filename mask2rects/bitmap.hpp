@@ -0,0 +1,62 @@
+//
+// Copyright 2013 Cole Minor <c.minor@inbox.com>
+//
+//    This file is part of mask2rects.
+//
+//    mask2rects is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    mask2rects is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with mask2rects.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef MASK2RECTS_BITMAP_HPP
+#define MASK2RECTS_BITMAP_HPP
+
+#include <cstddef>
+#include <stdint.h>
+#include <vector>
+
+// One bit per point, packed into 64-bit words. Every row starts on a
+// new word and the bits past the end of a row are always clear, so
+// rows can be tested, filled and counted a word at a time.
+class Bitmap {
+private:
+  int m_width, m_height, m_stride;
+  std::vector<uint64_t> m_words;
+
+  const uint64_t *row(int y) const { return &m_words[y * m_stride]; }
+  uint64_t *row(int y) { return &m_words[y * m_stride]; }
+
+public:
+  Bitmap();
+  Bitmap(int w, int h);
+
+  int width() const { return m_width; }
+  int height() const { return m_height; }
+  void resize(int w, int h);
+  void clear() { resize(0, 0); }
+
+  bool get(int x, int y) const {
+    return row(y)[x >> 6] >> (x & 63) & 1;
+  }
+  void set(int x, int y) { row(y)[x >> 6] |= 1ULL << (x & 63); }
+  void fill(int y, int x0, int x1, bool v);
+
+  bool all(int y, int x0, int x1) const;
+  bool all_column(int x, int y0, int y1) const;
+  bool same(const Bitmap &o, int y, int x0, int x1) const;
+  int next_set(int x, int y) const;
+  int next_clear(int x, int y) const;
+  size_t count() const;
+  size_t count(int y) const;
+  int select(int y, size_t k) const;
+};
+
+#endif // MASK2RECTS_BITMAP_HPP
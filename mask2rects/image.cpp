@@ -16,21 +16,53 @@
 //    You should have received a copy of the GNU General Public License
 //    along with mask2rects.  If not, see <http://www.gnu.org/licenses/>.
 //
+#include <png.h>
 #include <cerrno>
 #include <cstdio>
+#include <cstdlib>
 #include <cstring>
 #include <vector>
-#include "gd.h"
 
+#include "bitmap.hpp"
 #include "image.hpp"
 #include "log.hpp"
+#include "map.hpp"
+#include "point.hpp"
 #include "region.hpp"
 
 using namespace std;
 
-bool read_image(const string &filename,
-                vector<int> &bitmap,
-                int &width, int &height) {
+static void png_error_handler(png_structp png, png_const_charp m) {
+  logerr("libpng: %s", m);
+  longjmp(png_jmpbuf(png), 1);
+}
+
+static void png_warning_handler(png_structp, png_const_charp m) {
+  logver("libpng: %s", m);
+}
+
+// Any color channel above this marks a foreground point.
+#define FOREGROUND_THRESHOLD 125
+
+static void threshold_row(png_const_bytep row, int channels, int count,
+                          Bitmap &bitmap, int y, int x0, int dx) {
+  for (int i = 0, x = x0; i < count; ++i, x += dx) {
+    for (int c = 0; c < channels; ++c) {
+      if (row[i * channels + c] > FOREGROUND_THRESHOLD) {
+        bitmap.set(x, y);
+        break;
+      }
+    }
+  }
+}
+
+// The image is decoded a row at a time straight into the bitmap.
+// Interlaced images are read pass by pass as reduced images, each
+// row landing on its own spaced out points, so no more than one row
+// of pixels is ever held. Maps are read straight from their tiles.
+bool read_image(const string &filename, Bitmap &bitmap) {
+  if (is_map(filename))
+    return read_map(filename, bitmap);
 
   FILE *f;
   const char *fn = filename.c_str();
@@ -40,59 +72,160 @@ bool read_image(const string &filename,
     return false;
   }
 
-  gdImagePtr im;
-  im = gdImageCreateFromPng(f);
-  fclose(f);
-  
-  width = gdImageSX(im);
-  height = gdImageSY(im);
-  bitmap.resize(width * height, 0);
-
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      int c = gdImageGetPixel(im, x, y);
-      int p = x + y * width;
-      if (gdImageRed(im, c) > 125
-          || gdImageGreen(im, c > 125)
-          || gdImageBlue(im, c > 125)) {
-        bitmap[p] = 1;
+  png_structp png;
+  png_infop info = 0;
+  png_bytep volatile row = 0;
+  png = png_create_read_struct(PNG_LIBPNG_VER_STRING, 0,
+                               png_error_handler, png_warning_handler);
+  if (png)
+    info = png_create_info_struct(png);
+  if (!png || !info) {
+    logerr("failed to set up PNG decoder for '%s'", fn);
+    png_destroy_read_struct(&png, 0, 0);
+    fclose(f);
+    return false;
+  }
+  if (setjmp(png_jmpbuf(png))) {
+    logerr("failed to read PNG image '%s'", fn);
+    png_destroy_read_struct(&png, &info, 0);
+    free(row);
+    fclose(f);
+    return false;
+  }
+
+  png_init_io(png, f);
+  png_read_info(png, info);
+  png_set_expand(png);
+  png_set_strip_16(png);
+  png_set_strip_alpha(png);
+  png_read_update_info(png, info);
+
+  int width = png_get_image_width(png, info);
+  int height = png_get_image_height(png, info);
+  int channels = png_get_channels(png, info);
+  bool interlaced =
+    png_get_interlace_type(png, info) == PNG_INTERLACE_ADAM7;
+  bitmap.resize(width, height);
+  row = static_cast<png_bytep>(malloc(png_get_rowbytes(png, info)));
+
+  if (!interlaced) {
+    for (int y = 0; y < height; ++y) {
+      png_read_row(png, row, 0);
+      threshold_row(row, channels, width, bitmap, y, 0, 1);
+    }
+  } else {
+    for (int pass = 0; pass < 7; ++pass) {
+      int cols = PNG_PASS_COLS(width, pass);
+      int rows = PNG_PASS_ROWS(height, pass);
+      if (!cols || !rows)
+        continue;
+      int x0 = PNG_PASS_START_COL(pass);
+      int dx = 1 << PNG_PASS_COL_SHIFT(pass);
+      for (int i = 0; i < rows; ++i) {
+        png_read_row(png, row, 0);
+        int y = PNG_ROW_FROM_PASS_ROW(i, pass);
+        threshold_row(row, channels, cols, bitmap, y, x0, dx);
       }
     }
   }
 
-  gdImageDestroy(im);
+  png_read_end(png, 0);
+  png_destroy_read_struct(&png, &info, 0);
+  free(row);
+  fclose(f);
+
+  logver("read %dx%d PNG image '%s'", width, height, fn);
   return true;
 }
 
-
-bool write_image(const string &filename,
-                 const vector<int> &bitmap,
-                 int width, int height) {
-
+// Encodes an image held as one byte per point: palette indices if
+// a palette is given, otherwise 0 or 1 for a 1-bit grayscale image.
+static bool write_png(const string &filename, int width, int height,
+                      const vector<png_byte> &pixels,
+                      const png_color *palette, int colors) {
   FILE *f;
   const char *fn = filename.c_str();
-  logver("going to write image '%s'", fn);
   if (!(f = fopen(fn, "wb"))) {
     logerr("failed to open '%s' for writing: %s", fn, strerror(errno));
-    return 0;
+    return false;
+  }
+
+  png_structp png;
+  png_infop info = 0;
+  png = png_create_write_struct(PNG_LIBPNG_VER_STRING, 0,
+                                png_error_handler, png_warning_handler);
+  if (png)
+    info = png_create_info_struct(png);
+  if (!png || !info) {
+    logerr("failed to set up PNG encoder for '%s'", fn);
+    png_destroy_write_struct(&png, 0);
+    fclose(f);
+    return false;
+  }
+  if (setjmp(png_jmpbuf(png))) {
+    logerr("failed to write PNG image '%s'", fn);
+    png_destroy_write_struct(&png, &info);
+    fclose(f);
+    return false;
   }
 
-  gdImagePtr im = gdImageCreate(width, height);
-  gdImageColorAllocate(im, 0, 0, 0); /* background */
-  int white = gdImageColorAllocate(im, 255, 255, 255);
+  png_init_io(png, f);
+  if (palette) {
+    png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_PALETTE,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+    png_set_PLTE(png, info, palette, colors);
+  } else {
+    png_set_IHDR(png, info, width, height, 1, PNG_COLOR_TYPE_GRAY,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+                 PNG_FILTER_TYPE_DEFAULT);
+  }
+  png_write_info(png, info);
+  png_set_packing(png);
+  for (int y = 0; y < height; ++y)
+    png_write_row(png, &pixels[(size_t)y * width]);
+  png_write_end(png, info);
+  png_destroy_write_struct(&png, &info);
 
-  for (int y = 0; y < height; ++y) {
-    for (int x = 0; x < width; ++x) {
-      int p = x + y * width;
-      if (!bitmap[p])
-        continue;
-      gdImageSetPixel(im, x, y, white);
+  if (fclose(f)) {
+    logerr("failed to write PNG image '%s': %s", fn, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+// sets x0..x1, y0..y1 inclusive to c in an image w points wide
+static void fill_box(vector<png_byte> &pixels, int w,
+                     int x0, int y0, int x1, int y1, png_byte c) {
+  for (int y = y0; y <= y1; ++y)
+    memset(&pixels[(size_t)y * w + x0], c, x1 - x0 + 1);
+}
+
+// sets the foreground runs of b, placed at o, to c
+static void fill_bitmap(vector<png_byte> &pixels, int w,
+                        const Bitmap &b, Point o, png_byte c) {
+  for (int y = 0; y < b.height(); ++y) {
+    png_byte *p = &pixels[(size_t)(o.y + y) * w + o.x];
+    int x = 0;
+    while ((x = b.next_set(x, y)) < b.width()) {
+      int e = b.next_clear(x, y);
+      memset(p + x, c, e - x);
+      x = e;
     }
   }
+}
 
-  gdImagePng(im, f);
-  fclose(f);
-  gdImageDestroy(im);
+bool write_image(const string &filename, const Bitmap &bitmap) {
+  const char *fn = filename.c_str();
+  logver("going to write image '%s'", fn);
+
+  int width = bitmap.width();
+  int height = bitmap.height();
+  vector<png_byte> pixels((size_t)width * height, 0);
+  fill_bitmap(pixels, width, bitmap, Point(), 1);
+
+  if (!write_png(filename, width, height, pixels, 0, 0))
+    return false;
   logver("wrote %dx%d PNG image to '%s'", width, height, fn);
   return true;
 }
@@ -116,62 +249,57 @@ static int color_list[][3] = {
   {154, 77, 66},
 };
 
+// palette indices ahead of the cover colors
+enum { BLACK, WHITE, GREEN, FIRST_COLOR };
+
+// The overlay is painted into a buffer of palette indices a run at
+// a time and encoded once at the end.
 bool render_image(const string &filename, Region &r) {
   const char *fn = filename.c_str();
   logver("going to render %dx%d region to image '%s'", r.width(), r.height(), fn);
 
-  gdImagePtr im;
-  im = gdImageCreate(r.width(), r.height());
-  gdImageColorAllocate(im, 0, 0, 0); // background
-  int white = gdImageColorAllocate(im, 255, 255, 255);
-  int green = gdImageColorAllocate(im, 100, 200, 100);
-
-  vector<int> ca;
-  int ci = 0;
+  png_color palette[FIRST_COLOR + N_COLORS] = {
+    {0, 0, 0},  // background
+    {255, 255, 255},
+    {100, 200, 100},
+  };
   for (unsigned i = 0; i < N_COLORS; i++) {
-    int r = color_list[i][0];
-    int g = color_list[i][1];
-    int b = color_list[i][2];
-    ca.push_back(gdImageColorAllocate(im, r, g, b));
+    palette[FIRST_COLOR + i].red = color_list[i][0];
+    palette[FIRST_COLOR + i].green = color_list[i][1];
+    palette[FIRST_COLOR + i].blue = color_list[i][2];
   }
 
+  int w = r.width();
+  vector<png_byte> pixels((size_t)w * r.height(), BLACK);
   RegionList &regions = r.get_regions();
+  int ci = 0;
 
   for (RegionList::iterator i = regions.begin(); i != regions.end(); ++i) {
     Region *s = *i;
     Point o = s->origin();
-    for (int y = 0; y < s->height(); ++y) {
-      int v = o.y + y;
-      for (int x = 0; x < s->width(); ++x) {
-        int u = o.x + x;
-        if (s->get(x, y)) 
-          gdImageSetPixel(im, u, v, white);
-      }
-    }
+    fill_bitmap(pixels, w, s->bitmap(), o, WHITE);
+
     int u0 = o.x;
     int v0 = o.y;
     int u1 = o.x + s->width() - 1;
     int v1 = o.y + s->height() - 1;
-    gdImageRectangle(im, u0, v0, u1, v1, green);
+    fill_box(pixels, w, u0, v0, u1, v0, GREEN);
+    fill_box(pixels, w, u0, v1, u1, v1, GREEN);
+    fill_box(pixels, w, u0, v0, u0, v1, GREEN);
+    fill_box(pixels, w, u1, v0, u1, v1, GREEN);
 
     Cover &cover = s->get_cover();
 
     for (Cover::iterator b = cover.begin(); b != cover.end(); ++b) {
-      gdImageFilledRectangle(im, o.x + b->x0, o.y + b->y0,
-                             o.x + b->x1, o.y + b->y1, ca[ci]);
+      fill_box(pixels, w, o.x + b->x0, o.y + b->y0,
+               o.x + b->x1, o.y + b->y1, FIRST_COLOR + ci);
       ci = (ci + 1) % N_COLORS;
     }
   }
 
-  FILE *f;
-  if (!(f = fopen(fn, "wb"))) {
-    logerr("failed to open '%s' for writing: %s", fn, strerror(errno));
+  if (!write_png(filename, w, r.height(), pixels, palette,
+                 FIRST_COLOR + N_COLORS))
     return false;
-  }
-
-  gdImagePng(im, f);
-  fclose(f);
-  gdImageDestroy(im);
 
   loginfo("wrote PNG image to '%s'", fn);
 
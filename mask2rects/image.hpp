@@ -20,15 +20,12 @@
 #define MASK2RECTS_IMAGE_HPP
 
 #include <string>
-#include <vector>
 
-bool read_image(const std::string &file,
-                std::vector<int> &bitmap,
-                int &width, int &height);
+class Bitmap;
 
-bool write_image(const std::string &file,
-                 const std::vector<int> &bitmap,
-                 int width, int height);
+bool read_image(const std::string &file, Bitmap &bitmap);
+
+bool write_image(const std::string &file, const Bitmap &bitmap);
 
 class Region;
 
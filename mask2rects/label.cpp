@@ -18,22 +18,37 @@
 //
 #include "label.hpp"
 
-Label::Label(int v)
-  :m_root(this), m_rank(0), m_value(v) {
+Labels::Labels(int n)
+  :m_parent(n) {
+  for (int i = 0; i < n; ++i)
+    m_parent[i] = i;
 }
 
-Label *Label::root() {
-  if (m_root != this)
-    m_root = m_root->root();
-  return m_root;
+// Path halving only ever replaces a parent with a smaller
+// ancestor, which is safe to race with other finds and joins.
+int Labels::root(int l) {
+  int p;
+  while ((p = parent(l)) != l) {
+    int g = parent(p);
+    if (g != p)
+      __sync_bool_compare_and_swap(&m_parent[l], p, g);
+    l = g;
+  }
+  return l;
 }
 
-void Label::join(Label *other) {
-  if (other->m_rank < m_rank) {
-    other->m_root = this;
-  } else {
-    m_root = other;
-    if (m_rank == other->m_rank)
-      other->m_rank++;
+void Labels::join(int a, int b) {
+  for (;;) {
+    a = root(a);
+    b = root(b);
+    if (a == b)
+      return;
+    if (a < b) {
+      int t = a;
+      a = b;
+      b = t;
+    }
+    if (__sync_bool_compare_and_swap(&m_parent[a], a, b))
+      return;
   }
 }
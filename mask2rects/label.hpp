@@ -19,20 +19,25 @@
 #ifndef MASK2RECTS_LABEL_HPP
 #define MASK2RECTS_LABEL_HPP
 
-class Label;
+#include <vector>
 
-class Label {
+// Disjoint sets of labels 0..n-1 that may be joined from several
+// threads at once. Sets are always linked to their smallest label,
+// so the roots found do not depend on the order of the joins.
+class Labels {
 private:
-  Label *m_root;
-  int m_rank;
-  int m_value;
+  std::vector<int> m_parent;
+
+  int parent(int l) const {
+    return *static_cast<const volatile int *>(&m_parent[l]);
+  }
 
 public:
-  Label(int value);
+  Labels(int count);
 
-  int value() const { return m_value; }
-  Label *root();
-  void join(Label *other);
+  int size() const { return m_parent.size(); }
+  int root(int l);
+  void join(int a, int b);
 };
 
 #endif // MASK2RECTS_LABEL_HPP
@@ -16,72 +16,240 @@
 //    You should have received a copy of the GNU General Public License
 //    along with mask2rects.  If not, see <http://www.gnu.org/licenses/>.
 //
+#include <algorithm>
 #include <cerrno>
 #include <cstdio>
 #include <cstring>
+#include <string>
+#include <vector>
 
+#include "box.hpp"
 #include "image.hpp"
 #include "log.hpp"
 #include "options.hpp"
+#include "previous.hpp"
 #include "random.hpp"
 #include "region.hpp"
+#include "report.hpp"
+#include "thread.hpp"
+#include "timer.hpp"
 
 using namespace std;
 
-int main(int argc, char **argv) {
-  if (!parse_command_line(argc, argv))
-    return 1;
+// Reads the masks concurrently.
+class ReadJob : public Job {
+public:
+  vector<Region *> &masks;
+  vector<char> ok;
 
-  if (opts.arguments.size() < 1) {
-    logerr("missing input image argument");
-    return 1;
-  }
+  ReadJob(vector<Region *> &m):masks(m), ok(m.size(), 0) {}
+  void run(size_t i) { ok[i] = masks[i]->read(opts.masks[i].file); }
+};
 
-  initialize_rng(opts.random_seed);
+// Covers the regions of all masks concurrently, largest first, so
+// the biggest regions are not left waiting behind many small ones.
+class CoverJob : public Job {
+public:
+  vector<Region *> regions;
+  vector<unsigned> streams;
+  vector<double> budgets;
 
-  Region r;
-  if (!r.read(opts.arguments[0]))
-    return 1;
-  
-  r.calculate_connected_regions();
-  RegionList &regions = r.get_regions();
+  CoverJob(vector<Region *> &masks);
+  void run(size_t i) {
+    regions[i]->calculate_cover(streams[i], budgets[i]);
+  }
+};
 
-  FILE *f;
-  const char *fn = opts.output_rects_file.c_str();
-  if (!(f = fopen(fn, "w"))) {
-    logerr("failed to open '%s' for writing: %s", fn, strerror(errno));
-    return 1;
+static bool larger_region(const pair<int, unsigned> &a,
+                          const pair<int, unsigned> &b) {
+  return a.first > b.first;
+}
+
+// Regions are numbered across all masks in order for their random
+// streams, so a single mask is covered the same as on its own.
+// Regions keeping a previous cover are left out.
+// The time budget is shared out as trial seconds in proportion to
+// foreground area. Trials of all regions run on every thread, so
+// the budget is multiplied by the thread count to cover about the
+// same length of wall clock time.
+CoverJob::CoverJob(vector<Region *> &masks)
+  :regions(), streams(), budgets() {
+  vector<Region *> v;
+  for (size_t m = 0; m < masks.size(); ++m) {
+    RegionList &l = masks[m]->get_regions();
+    v.insert(v.end(), l.begin(), l.end());
   }
+  vector<pair<int, unsigned> > order;
+  for (unsigned i = 0; i < v.size(); ++i)
+    order.push_back(make_pair(v[i]->size(), i));
+  stable_sort(order.begin(), order.end(), larger_region);
 
-  if (opts.flip_rectangle_y_coordinates)
-    loginfo("Flipping y coordinates in output to '%s'", fn);
+  double total = 0;
+  vector<double> areas;
+  for (size_t i = 0; i < order.size(); ++i) {
+    if (v[order[i].second]->reused())
+      continue;
+    regions.push_back(v[order[i].second]);
+    streams.push_back(order[i].second);
+    areas.push_back(opts.time_budget > 0 ? regions.back()->count() : 0);
+    total += areas.back();
+  }
+  double share = total > 0 ? opts.time_budget * thread_count() / total : 0;
+  for (size_t i = 0; i < areas.size(); ++i)
+    budgets.push_back(areas[i] * share);
+}
 
+// Gets the cover rectangles of a mask in output coordinates.
+static void get_rects(Region &r, vector<Box> &rects) {
+  RegionList &regions = r.get_regions();
   int h = r.height();
   for (RegionList::iterator i = regions.begin(); i != regions.end(); ++i) {
     Region *s = *i;
     Point o = s->origin();
-
-    s->calculate_cover();
     Cover& cover = s->get_cover();
 
     for (Cover::iterator b = cover.begin(); b != cover.end(); ++b) {
-      int x0 = o.x + b->x0;
-      int y0 = o.y + b->y0;
-      int x1 = o.x + b->x1;
-      int y1 = o.y + b->y1;
+      Box n = *b;
+      n.x0 += o.x;
+      n.y0 += o.y;
+      n.x1 += o.x;
+      n.y1 += o.y;
       if (opts.flip_rectangle_y_coordinates) {
-        int t = y0;
-        y0 = h - 1 - y1;
-        y1 = h - 1 - t;
+        int t = n.y0;
+        n.y0 = h - 1 - n.y1;
+        n.y1 = h - 1 - t;
       }
-      fprintf(f, "%d,%d,%d,%d\n", x0, y0, x1, y1);
+      rects.push_back(n);
     }
   }
-  fclose(f);
-  loginfo("wrote rectangle bounds to '%s'", fn);
+}
+
+static void write_rects(FILE *f, const vector<Box> &rects) {
+  for (size_t i = 0; i < rects.size(); ++i) {
+    const Box &b = rects[i];
+    fprintf(f, "%d,%d,%d,%d\n", b.x0, b.y0, b.x1, b.y1);
+  }
+}
+
+// Same format as rects2def.pl, trailing space after min_y included.
+static void write_def(FILE *f, const MaskSpec &m, const vector<Box> &rects) {
+  const char *d = m.section.c_str();
+  for (size_t i = 0; i < rects.size(); ++i) {
+    const Box &b = rects[i];
+    fprintf(f, "[%s]\nmin_x: %d\nmin_y: %d \nmax_x: %d\nmax_y: %d\n",
+            d, b.x0, b.y0, b.x1, b.y1);
+    for (size_t j = 0; j < m.values.size(); ++j) {
+      fprintf(f, "%s: %s\n", m.values[j].first.c_str(),
+              m.values[j].second.c_str());
+    }
+    fprintf(f, "[/%s]\n", d);
+  }
+}
+
+// Opens an optional output file, leaving f null if it is not set.
+static bool open_output(const string &filename, FILE *&f) {
+  const char *fn = filename.c_str();
+  if (filename.size() && !(f = fopen(fn, "w"))) {
+    logerr("failed to open '%s' for writing: %s", fn, strerror(errno));
+    return false;
+  }
+  return true;
+}
+
+static bool close_output(FILE *f, const string &filename, bool ok) {
+  if (fclose(f) || !ok) {
+    logerr("failed to write '%s'", filename.c_str());
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  if (!parse_command_line(argc, argv))
+    return 1;
+
+  if (opts.masks.size() < 1) {
+    logerr("missing input image argument");
+    return 1;
+  }
+
+  initialize_rng(opts.random_seed);
+
+  Timings times;
+  Timer t;
+  t.start();
+  vector<Region *> masks;
+  for (size_t i = 0; i < opts.masks.size(); ++i)
+    masks.push_back(new Region());
+  ReadJob read(masks);
+  run_parallel(read, masks.size());
+  for (size_t i = 0; i < masks.size(); ++i) {
+    if (!read.ok[i])
+      return 1;
+  }
+  t.stop();
+  times.read = t.value();
+
+  t.start();
+  for (size_t i = 0; i < masks.size(); ++i)
+    masks[i]->calculate_connected_regions();
+  if (opts.previous_mask.size()
+      && !keep_previous_covers(*masks[0], opts.previous_mask,
+                               opts.previous_rects_file))
+    return 1;
+  t.stop();
+  times.label = t.value();
+
+  FILE *f = 0, *def = 0, *report = 0;
+  if (!open_output(opts.output_rects_file, f)
+      || !open_output(opts.def_file, def)
+      || !open_output(opts.report_file, report))
+    return 1;
+
+  if (opts.flip_rectangle_y_coordinates)
+    loginfo("Flipping y coordinates in output");
+
+  t.start();
+  CoverJob job(masks);
+  run_parallel(job, job.regions.size());
+  t.stop();
+  times.cover = t.value();
+
+  t.start();
+  for (size_t i = 0; i < masks.size(); ++i) {
+    vector<Box> rects;
+    get_rects(*masks[i], rects);
+    if (f)
+      write_rects(f, rects);
+    if (def)
+      write_def(def, opts.masks[i], rects);
+  }
+  if (f) {
+    if (!close_output(f, opts.output_rects_file, !ferror(f)))
+      return 1;
+    loginfo("wrote rectangle bounds to '%s'",
+            opts.output_rects_file.c_str());
+  }
+  if (def) {
+    if (!close_output(def, opts.def_file, !ferror(def)))
+      return 1;
+    loginfo("wrote def sections to '%s'", opts.def_file.c_str());
+  }
 
   if (opts.output_image_file.size())
-    render_image(opts.output_image_file, r);
+    render_image(opts.output_image_file, *masks[0]);
+  t.stop();
+  times.output = t.value();
+
+  if (report) {
+    if (!close_output(report, opts.report_file,
+                      write_report(report, masks, times)))
+      return 1;
+    loginfo("wrote report to '%s'", opts.report_file.c_str());
+  }
+
+  for (size_t i = 0; i < masks.size(); ++i)
+    delete masks[i];
 
   logver("all done");
   return 0;
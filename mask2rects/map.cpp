@@ -0,0 +1,78 @@
+//
+// Copyright 2013 Cole Minor <c.minor@inbox.com>
+//
+//    This file is part of mask2rects.
+//
+//    mask2rects is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    mask2rects is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with mask2rects.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <cstring>
+
+#include "elm.h"
+
+#include "bitmap.hpp"
+#include "log.hpp"
+#include "map.hpp"
+
+using namespace std;
+
+static bool ends_with(const string &s, const char *e) {
+  size_t n = strlen(e);
+  return s.size() > n && !s.compare(s.size() - n, n, e);
+}
+
+bool is_map(const string &filename) {
+  return ends_with(filename, ".elm") || ends_with(filename, ".elm.gz");
+}
+
+bool read_map(const string &filename, Bitmap &bitmap) {
+  const char *fn = filename.c_str();
+  logver("going to read map '%s'", fn);
+
+  char e[512];
+  elm_t *m = elm_open(fn, e, sizeof e);
+  if (!m) {
+    logerr("failed to read map '%s': %s", fn, e);
+    return false;
+  }
+  elm_section_t v;
+  if (elm_section(m, ELM_TILES, &v)) {
+    logerr("failed to read map '%s': %s", fn, elm_error(m));
+    elm_close(m);
+    return false;
+  }
+
+  const elm_header_t *h = elm_header(m);
+  int width = 6 * h->terrain_x;
+  int height = 6 * h->terrain_y;
+  bitmap.resize(width, height);
+
+  // rows of walkable tiles are set a run at a time
+  for (int y = 0; y < height; ++y) {
+    const uint8_t *t = v.data + (size_t)(height - 1 - y) * width;
+    int x = 0;
+    while (x < width) {
+      while (x < width && !t[x])
+        ++x;
+      int s = x;
+      while (x < width && t[x])
+        ++x;
+      if (s < x)
+        bitmap.fill(y, s, x - 1, true);
+    }
+  }
+  elm_close(m);
+
+  logver("read %dx%d map '%s'", width, height, fn);
+  return true;
+}
@@ -16,9 +16,13 @@
 //    You should have received a copy of the GNU General Public License
 //    along with mask2rects.  If not, see <http://www.gnu.org/licenses/>.
 //
+#include <cmath>
 #include <cstdio>
 #include <cstdlib>
-#include <unistd.h>
+#include <cstring>
+#include <getopt.h>
+#include <string>
+#include <utility>
 #include <vector>
 
 using namespace std;
@@ -30,7 +34,12 @@ Options opts;
 static void usage(void) {
   fprintf(stderr,
     "\n"
-    "Usage: mask2rects [options] <PNG image mask>\n\n"
+    "Usage: mask2rects [options] <mask>[,<section>[,<key>=<value>...]]...\n\n"
+    "Each mask is a PNG image, or an ELM map, optionally gzip\n"
+    "compressed, whose walkable tiles are read with north up.\n"
+    "Several masks may be given, and all are covered together.\n"
+    "The section name and key/value pairs following a mask are\n"
+    "used for its rectangles in the def file.\n\n"
     "Options: \n\n"
     "-a <number>    default 1\n"
     "    Minimum area of covering rectangles. Any rectangles\n"
@@ -38,24 +47,56 @@ static void usage(void) {
     "    value will be skipped.\n\n"
     "-c <number>    default 50\n"
     "    Maximum number of rectangles used to cover each region.\n\n"
+    "--def=<filename>  string option\n"
+    "    If this option is set, a server def file will be written\n"
+    "    to the given file, with a section for every rectangle of\n"
+    "    each mask giving its bounds and the mask's key/value pairs,\n"
+    "    as rects2def.pl does. Every mask then needs a section name.\n\n"
     "-d             boolean option\n"
     "    Print all verbose message along with extra debugging\n"
     "    information.\n\n"
     "-f             boolean option\n"
     "    Flip all y-coordinate (vertical) values in the output\n"
     "    rectangle list.\n\n"
+    "-g, --growth <name>  default \"edges\"\n"
+    "    How rectangles are grown from each random starting point.\n"
+    "    \"edges\" moves one side at a time by a row or column in\n"
+    "    turn, \"histogram\" finds the largest rectangle of uncovered\n"
+    "    points containing the starting point in one step.\n\n"
     "-i <number>    default 10\n"
     "    Maximum number of iterations of the fitting algorithm.\n"
     "    A good cover will try to be found for each region this\n"
-    "    number of times before giving up.\n\n"
+    "    number of times before giving up. At least one is needed.\n\n"
     "-o <filename>  default \"output-rects.txt\"\n"
-    "    The computed rectangles will be written to this file.\n\n"
+    "    The computed rectangles of all masks will be written to\n"
+    "    this file, in the order the masks are given. If --def is\n"
+    "    set the file is only written when this option is too.\n\n"
+    "--previous=<mask>,<filename>  string option\n"
+    "    A previous version of the mask and the rectangle list\n"
+    "    written for it. Regions that have not changed keep their\n"
+    "    rectangles and only the others are covered again. The\n"
+    "    list must have been written with the same -f setting.\n"
+    "    Only a single mask may be given.\n\n"
     "-r <filename>  string option\n"
     "    If this option is set, a PNG image will be written to the\n"
-    "    given file showing the regions and rectangle covers found.\n\n"
+    "    given file showing the regions and rectangle covers found.\n"
+    "    Only a single mask may be given.\n\n"
+    "--report=<filename>  string option\n"
+    "    If this option is set, a JSON report will be written to\n"
+    "    the given file giving the size, iterations, time taken,\n"
+    "    rectangle count and uncovered points of each region's\n"
+    "    cover, and the time spent in each stage of the run.\n\n"
     "-s <number>    default -1\n"
     "    Seed used for random number generation. The default value\n"
     "    causes the current system time to be used.\n\n"
+    "-t <number>    default 0\n"
+    "    Number of threads to use. The default value causes one\n"
+    "    thread to be used per online processor.\n\n"
+    "--time-budget=<seconds>  default 0\n"
+    "    Search for covers for about this long in total instead of\n"
+    "    for a fixed number of iterations, and ignore -i. Each\n"
+    "    region is given a share in proportion to its area. The\n"
+    "    result then depends on the speed of the machine.\n\n"
     "-u <number>    default 0\n"
     "    Maximum number of uncovered points to permit per region.\n"
     "    Points that would have been covered by rectangles omitted\n"
@@ -63,6 +104,11 @@ static void usage(void) {
     "-v             boolean option\n"
     "    Enable verbose messages. More detailed information will\n"
     "    be printed to stdout about what is going on.\n\n"
+    "-x, --exact    boolean option\n"
+    "    Compute a minimum partition of each region into rectangles\n"
+    "    directly instead of searching randomly. The -i and -s\n"
+    "    options have no effect, and the result is the same on\n"
+    "    every run.\n\n"
   );
 }
 
@@ -71,13 +117,66 @@ static void set_option_defaults() {
   opts.maximum_box_count = 50;
   opts.flip_rectangle_y_coordinates = false;
   opts.maximum_iterations = 10;
-  opts.output_rects_file = "output-rects.txt";
+  opts.exact_cover = false;
+  opts.growth = GROW_EDGES;
+  opts.output_rects_file = "";
   opts.output_image_file = "";
+  opts.report_file = "";
+  opts.def_file = "";
+  opts.previous_mask = "";
+  opts.previous_rects_file = "";
   opts.random_seed = -1;
   opts.maximum_uncovered_points = 0;
+  opts.thread_count = 0;
+  opts.time_budget = 0;
   opts.verbose = false;
   opts.debug = false;
-  opts.arguments.clear();
+  opts.masks.clear();
+}
+
+static const char short_options[] = "a:c:dfg:hi:o:r:s:t:u:vx";
+
+// long options without a short form
+enum { OPT_REPORT = 256, OPT_TIME_BUDGET, OPT_DEF, OPT_PREVIOUS };
+
+static const struct option long_options[] = {
+  {"def", required_argument, 0, OPT_DEF},
+  {"exact", no_argument, 0, 'x'},
+  {"growth", required_argument, 0, 'g'},
+  {"previous", required_argument, 0, OPT_PREVIOUS},
+  {"report", required_argument, 0, OPT_REPORT},
+  {"time-budget", required_argument, 0, OPT_TIME_BUDGET},
+  {0, 0, 0, 0}
+};
+
+// Splits <mask>[,<section>[,<key>=<value>...]] into its parts.
+static bool parse_mask(const string &arg, MaskSpec &m) {
+  vector<string> parts;
+  size_t p = 0, q;
+  while ((q = arg.find(',', p)) != string::npos) {
+    parts.push_back(arg.substr(p, q - p));
+    p = q + 1;
+  }
+  parts.push_back(arg.substr(p));
+
+  m.file = parts[0];
+  if (parts.size() > 1)
+    m.section = parts[1];
+  if (m.file.empty() || (parts.size() > 1 && m.section.empty())) {
+    fprintf(stderr, "invalid mask argument '%s'\n", arg.c_str());
+    return false;
+  }
+  for (size_t i = 2; i < parts.size(); ++i) {
+    size_t e = parts[i].find('=');
+    if (e == string::npos || e == 0 || e + 1 == parts[i].size()) {
+      fprintf(stderr, "invalid key=value '%s' for mask '%s'\n",
+              parts[i].c_str(), m.file.c_str());
+      return false;
+    }
+    m.values.push_back(make_pair(parts[i].substr(0, e),
+                                 parts[i].substr(e + 1)));
+  }
+  return true;
 }
 
 bool parse_command_line(int argc, char **argv) {
@@ -85,7 +184,8 @@ bool parse_command_line(int argc, char **argv) {
   set_option_defaults();
 
   int o;
-  while ((o = getopt(argc, argv, "a:c:dfhi:o:r:s:u:v")) != -1) {
+  while ((o = getopt_long(argc, argv, short_options,
+                          long_options, 0)) != -1) {
     switch (o) {
     case 'a':
       opts.minimum_box_area = atoi(optarg);
@@ -96,13 +196,30 @@ bool parse_command_line(int argc, char **argv) {
     case 'd':
       opts.debug = true;
       break;
+    case OPT_DEF:
+      opts.def_file = optarg;
+      break;
     case 'f':
       opts.flip_rectangle_y_coordinates = 1;
       break;
+    case 'g':
+      if (!strcmp(optarg, "edges")) {
+        opts.growth = GROW_EDGES;
+      } else if (!strcmp(optarg, "histogram")) {
+        opts.growth = GROW_HISTOGRAM;
+      } else {
+        fprintf(stderr, "unknown growth strategy '%s'\n", optarg);
+        return false;
+      }
+      break;
     case 'h':
       usage();
       return false;
     case 'i':
+      if (atoi(optarg) < 1) {
+        fprintf(stderr, "invalid iteration count '%s'\n", optarg);
+        return false;
+      }
       opts.maximum_iterations = atoi(optarg);
       break;
     case 'o':
@@ -111,23 +228,74 @@ bool parse_command_line(int argc, char **argv) {
     case 'r':
       opts.output_image_file = optarg;
       break;
+    case OPT_PREVIOUS: {
+      const char *c = strchr(optarg, ',');
+      if (!c || c == optarg || !c[1]) {
+        fprintf(stderr, "invalid previous mask and rectangles '%s'\n",
+                optarg);
+        return false;
+      }
+      opts.previous_mask.assign(optarg, c - optarg);
+      opts.previous_rects_file = c + 1;
+      break;
+    }
+    case OPT_REPORT:
+      opts.report_file = optarg;
+      break;
     case 's':
       opts.random_seed = atoi(optarg);
       break;
+    case 't':
+      if (atoi(optarg) < 0) {
+        fprintf(stderr, "invalid thread count '%s'\n", optarg);
+        return false;
+      }
+      opts.thread_count = atoi(optarg);
+      break;
+    case OPT_TIME_BUDGET:
+      opts.time_budget = atof(optarg);
+      if (!isfinite(opts.time_budget) || opts.time_budget < 0) {
+        fprintf(stderr, "invalid time budget '%s'\n", optarg);
+        return false;
+      }
+      break;
     case 'u':
       opts.maximum_uncovered_points = atoi(optarg);
       break;
     case 'v':
       opts.verbose = true;
       break;
+    case 'x':
+      opts.exact_cover = true;
+      break;
     case '?':
     default:
       return false;
     }
   }
 
-  while (optind < argc)
-    opts.arguments.push_back(argv[optind++]);
+  while (optind < argc) {
+    MaskSpec m;
+    if (!parse_mask(argv[optind++], m))
+      return false;
+    if (opts.def_file.size() && m.section.empty()) {
+      fprintf(stderr, "missing section name for mask '%s'\n",
+              m.file.c_str());
+      return false;
+    }
+    opts.masks.push_back(m);
+  }
+
+  if (opts.output_image_file.size() && opts.masks.size() > 1) {
+    fprintf(stderr, "only a single mask may be given with -r\n");
+    return false;
+  }
+  if (opts.previous_mask.size() && opts.masks.size() > 1) {
+    fprintf(stderr, "only a single mask may be given with --previous\n");
+    return false;
+  }
+  if (opts.output_rects_file.empty() && opts.def_file.empty())
+    opts.output_rects_file = "output-rects.txt";
 
   return true;
 }
@@ -22,19 +22,37 @@
 #include <string>
 #include <vector>
 
+enum growth_type { GROW_EDGES, GROW_HISTOGRAM };
+
+// A mask given on the command line, along with the def file section
+// name and extra key/value lines to write for each of its rectangles.
+struct MaskSpec {
+  std::string file;
+  std::string section;
+  std::vector<std::pair<std::string, std::string> > values;
+};
+
 struct Options {
   size_t minimum_box_area;
   size_t maximum_box_count;
   bool flip_rectangle_y_coordinates;
   size_t maximum_iterations;
+  bool exact_cover;
+  int growth;
   std::string output_rects_file;
   std::string output_image_file;
+  std::string report_file;
+  std::string def_file;
+  std::string previous_mask;
+  std::string previous_rects_file;
   int random_seed;
   size_t maximum_uncovered_points;
+  size_t thread_count;
+  double time_budget;
   bool verbose;
   bool debug;
 
-  std::vector<std::string> arguments;
+  std::vector<MaskSpec> masks;
 };
 
 extern Options opts;
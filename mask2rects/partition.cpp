@@ -0,0 +1,360 @@
+//
+// Copyright 2013 Cole Minor <c.minor@inbox.com>
+//
+//    This file is part of mask2rects.
+//
+//    mask2rects is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    mask2rects is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with mask2rects.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+#include <deque>
+#include <vector>
+
+#include "log.hpp"
+#include "partition.hpp"
+
+using namespace std;
+
+// Minimum partition of a rectilinear region into rectangles.
+//
+// Vertices are the lattice points between points of the region, so
+// vertex (i, j) is the corner shared by points (i-1, j-1), (i, j-1),
+// (i-1, j) and (i, j). A vertex is concave when exactly three of the
+// four are in the region. A chord joins two concave vertices along a
+// line through the inside of the region. The fewest rectangles come
+// from cutting along the largest set of chords that do not touch,
+// which is found as a maximum independent set of the bipartite
+// horizontal/vertical chord intersection graph, and then cutting
+// once more from every concave vertex left over.
+
+namespace {
+
+struct Chord {
+  int line, a, b;
+  Chord(int l, int a, int b):line(l), a(a), b(b) {}
+};
+
+class Partition {
+private:
+  const Region &m_region;
+  int m_width, m_height;
+  vector<Chord> m_horizontal, m_vertical;
+  vector<vector<int> > m_edges;
+  vector<int> m_mate_h, m_mate_v;
+  vector<char> m_cut_h, m_cut_v;
+
+  bool in(int x, int y) const {
+    return 0 <= x && x < m_width && 0 <= y && y < m_height
+      && m_region.get(x, y);
+  }
+  int corners(int i, int j) const {
+    return in(i - 1, j - 1) + in(i, j - 1) + in(i - 1, j) + in(i, j);
+  }
+  bool concave(int i, int j) const { return corners(i, j) == 3; }
+
+  // edge from vertex (i, j) to (i + 1, j)
+  bool inner_h(int i, int j) const { return in(i, j - 1) && in(i, j); }
+  char &cut_h(int i, int j) { return m_cut_h[i + j * m_width]; }
+  // edge from vertex (i, j) to (i, j + 1)
+  bool inner_v(int i, int j) const { return in(i - 1, j) && in(i, j); }
+  char &cut_v(int i, int j) { return m_cut_v[i + j * (m_width + 1)]; }
+
+  bool wall_h(int i, int j) { return !inner_h(i, j) || cut_h(i, j); }
+  bool wall_v(int i, int j) { return !inner_v(i, j) || cut_v(i, j); }
+
+  void find_chords();
+  void find_edges();
+  size_t match();
+  bool augment(int h, vector<int> &level);
+  void cut_chords();
+  void cut_remaining();
+  void extend(int i, int j, int di, int dj);
+  void collect(Cover &c);
+
+public:
+  Partition(const Region &r);
+  void run(Cover &c);
+};
+
+}
+
+Partition::Partition(const Region &r)
+  :m_region(r), m_width(r.width()), m_height(r.height()),
+   m_horizontal(), m_vertical(), m_edges(), m_mate_h(), m_mate_v(),
+   m_cut_h(m_width * (m_height + 1), 0),
+   m_cut_v((m_width + 1) * m_height, 0) {
+}
+
+// Chords only join consecutive concave vertices on a line, since an
+// inner segment can never pass through a concave vertex.
+void Partition::find_chords() {
+  for (int j = 1; j < m_height; ++j) {
+    int open = -1;
+    for (int i = 0; i <= m_width; ++i) {
+      if (concave(i, j) && open >= 0)
+        m_horizontal.push_back(Chord(j, open, i));
+      if (i == m_width || !inner_h(i, j))
+        open = -1;
+      else if (concave(i, j))
+        open = i;
+    }
+  }
+  for (int i = 1; i < m_width; ++i) {
+    int open = -1;
+    for (int j = 0; j <= m_height; ++j) {
+      if (concave(i, j) && open >= 0)
+        m_vertical.push_back(Chord(i, open, j));
+      if (j == m_height || !inner_v(i, j))
+        open = -1;
+      else if (concave(i, j))
+        open = j;
+    }
+  }
+}
+
+static bool point_less(const Point &p, const Point &q) {
+  return p.y < q.y || (p.y == q.y && p.x < q.x);
+}
+
+static bool chord_line_less(const Chord &c, int line) {
+  return c.line < line;
+}
+
+// Chords meeting at an end point count as intersecting too. The
+// vertical chords come out of find_chords() sorted by line.
+void Partition::find_edges() {
+  m_edges.resize(m_horizontal.size());
+  for (size_t h = 0; h < m_horizontal.size(); ++h) {
+    const Chord &c = m_horizontal[h];
+    vector<Chord>::const_iterator v;
+    v = lower_bound(m_vertical.begin(), m_vertical.end(), c.a,
+                    chord_line_less);
+    for (; v != m_vertical.end() && v->line <= c.b; ++v) {
+      if (v->a <= c.line && c.line <= v->b)
+        m_edges[h].push_back(v - m_vertical.begin());
+    }
+  }
+}
+
+// Hopcroft-Karp maximum matching of horizontal to vertical chords.
+size_t Partition::match() {
+  size_t nh = m_horizontal.size();
+  m_mate_h.assign(nh, -1);
+  m_mate_v.assign(m_vertical.size(), -1);
+  size_t matched = 0;
+  vector<int> level(nh);
+
+  for (;;) {
+    deque<int> queue;
+    bool found = false;
+    for (size_t h = 0; h < nh; ++h) {
+      if (m_mate_h[h] < 0) {
+        level[h] = 0;
+        queue.push_back(h);
+      } else {
+        level[h] = -1;
+      }
+    }
+    while (!queue.empty()) {
+      int h = queue.front();
+      queue.pop_front();
+      for (size_t k = 0; k < m_edges[h].size(); ++k) {
+        int m = m_mate_v[m_edges[h][k]];
+        if (m < 0) {
+          found = true;
+        } else if (level[m] < 0) {
+          level[m] = level[h] + 1;
+          queue.push_back(m);
+        }
+      }
+    }
+    if (!found)
+      break;
+    for (size_t h = 0; h < nh; ++h) {
+      if (m_mate_h[h] < 0 && augment(h, level))
+        ++matched;
+    }
+  }
+  return matched;
+}
+
+bool Partition::augment(int h, vector<int> &level) {
+  for (size_t k = 0; k < m_edges[h].size(); ++k) {
+    int v = m_edges[h][k];
+    int m = m_mate_v[v];
+    if (m < 0 || (level[m] == level[h] + 1 && augment(m, level))) {
+      m_mate_h[h] = v;
+      m_mate_v[v] = h;
+      return true;
+    }
+  }
+  level[h] = -1;
+  return false;
+}
+
+// By Koenig's theorem the chords reachable from unmatched horizontal
+// chords along alternating paths give the independent set: reached
+// horizontal chords and unreached vertical ones.
+void Partition::cut_chords() {
+  vector<char> seen_h(m_horizontal.size(), 0);
+  vector<char> seen_v(m_vertical.size(), 0);
+  deque<int> queue;
+  for (size_t h = 0; h < m_horizontal.size(); ++h) {
+    if (m_mate_h[h] < 0) {
+      seen_h[h] = 1;
+      queue.push_back(h);
+    }
+  }
+  while (!queue.empty()) {
+    int h = queue.front();
+    queue.pop_front();
+    for (size_t k = 0; k < m_edges[h].size(); ++k) {
+      int v = m_edges[h][k];
+      if (seen_v[v] || m_mate_h[h] == v)
+        continue;
+      seen_v[v] = 1;
+      int m = m_mate_v[v];
+      if (m >= 0 && !seen_h[m]) {
+        seen_h[m] = 1;
+        queue.push_back(m);
+      }
+    }
+  }
+
+  size_t n = 0;
+  for (size_t h = 0; h < m_horizontal.size(); ++h) {
+    if (!seen_h[h])
+      continue;
+    const Chord &c = m_horizontal[h];
+    for (int i = c.a; i < c.b; ++i)
+      cut_h(i, c.line) = 1;
+    ++n;
+  }
+  for (size_t v = 0; v < m_vertical.size(); ++v) {
+    if (seen_v[v])
+      continue;
+    const Chord &c = m_vertical[v];
+    for (int j = c.a; j < c.b; ++j)
+      cut_v(c.line, j) = 1;
+    ++n;
+  }
+  logver("cutting along %u of %u chords", n,
+         m_horizontal.size() + m_vertical.size());
+}
+
+// Cuts from (i, j) in direction (di, dj) until meeting a wall or
+// another cut running across.
+void Partition::extend(int i, int j, int di, int dj) {
+  for (;;) {
+    if (di) {
+      int e = di > 0 ? i : i - 1;
+      if (wall_h(e, j))
+        return;
+      cut_h(e, j) = 1;
+      i += di;
+      if (wall_v(i, j - 1) || wall_v(i, j))
+        return;
+    } else {
+      int e = dj > 0 ? j : j - 1;
+      if (wall_v(i, e))
+        return;
+      cut_v(i, e) = 1;
+      j += dj;
+      if (wall_h(i - 1, j) || wall_h(i, j))
+        return;
+    }
+  }
+}
+
+// Every concave vertex not at the end of a chosen chord still needs
+// one cut, made along its inner horizontal edge.
+void Partition::cut_remaining() {
+  for (int j = 1; j < m_height; ++j) {
+    for (int i = 1; i < m_width; ++i) {
+      if (!concave(i, j))
+        continue;
+      bool west = inner_h(i - 1, j), east = inner_h(i, j);
+      bool south = inner_v(i, j - 1), north = inner_v(i, j);
+      if ((west && cut_h(i - 1, j)) || (east && cut_h(i, j))
+          || (south && cut_v(i, j - 1)) || (north && cut_v(i, j)))
+        continue;
+      extend(i, j, east ? 1 : -1, 0);
+    }
+  }
+}
+
+// The pieces left between walls and cuts are gathered by flood
+// fill. They should all be rectangles; anything else is split into
+// its rows rather than trusted.
+void Partition::collect(Cover &c) {
+  vector<char> done(m_width * m_height, 0);
+  vector<Point> piece;
+  for (int y = 0; y < m_height; ++y) {
+    for (int x = 0; x < m_width; ++x) {
+      if (!in(x, y) || done[x + y * m_width])
+        continue;
+      Box b(x, y);
+      piece.clear();
+      piece.push_back(Point(x, y));
+      done[x + y * m_width] = 1;
+      for (size_t k = 0; k < piece.size(); ++k) {
+        Point p = piece[k];
+        b.add(p.x, p.y);
+        Point next[4] = {
+          Point(p.x + 1, p.y), Point(p.x - 1, p.y),
+          Point(p.x, p.y + 1), Point(p.x, p.y - 1)
+        };
+        bool open[4] = {
+          !wall_v(p.x + 1, p.y), !wall_v(p.x, p.y),
+          !wall_h(p.x, p.y + 1), !wall_h(p.x, p.y)
+        };
+        for (int d = 0; d < 4; ++d) {
+          Point &q = next[d];
+          if (open[d] && !done[q.x + q.y * m_width]) {
+            done[q.x + q.y * m_width] = 1;
+            piece.push_back(q);
+          }
+        }
+      }
+      if (piece.size() == b.area()) {
+        c.push_back(b);
+        continue;
+      }
+      logerr("partition piece at %d,%d is not a rectangle", x, y);
+      sort(piece.begin(), piece.end(), point_less);
+      for (size_t k = 0; k < piece.size(); ) {
+        Box r(piece[k]);
+        while (++k < piece.size() && piece[k].y == r.y0
+               && piece[k].x == r.x1 + 1)
+          r.x1++;
+        c.push_back(r);
+      }
+    }
+  }
+}
+
+void Partition::run(Cover &c) {
+  find_chords();
+  find_edges();
+  size_t m = match();
+  logver("found %u horizontal and %u vertical chords, %u matched",
+         m_horizontal.size(), m_vertical.size(), m);
+  cut_chords();
+  cut_remaining();
+  collect(c);
+}
+
+void find_partition(const Region &r, Cover &c) {
+  Partition p(r);
+  p.run(c);
+}
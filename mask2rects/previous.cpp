@@ -0,0 +1,175 @@
+//
+// Copyright 2013 Cole Minor <c.minor@inbox.com>
+//
+//    This file is part of mask2rects.
+//
+//    mask2rects is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    mask2rects is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with mask2rects.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "bitmap.hpp"
+#include "box.hpp"
+#include "image.hpp"
+#include "log.hpp"
+#include "options.hpp"
+#include "previous.hpp"
+#include "region.hpp"
+
+using namespace std;
+
+// Reads a rectangle list written by an earlier run, taking the
+// y-coordinates back out of flipped order if -f is set.
+static bool read_rects(const string &filename, int h, vector<Box> &rects) {
+  FILE *f;
+  const char *fn = filename.c_str();
+  if (!(f = fopen(fn, "r"))) {
+    logerr("failed to open '%s' for reading: %s", fn, strerror(errno));
+    return false;
+  }
+
+  char line[256];
+  while (fgets(line, sizeof(line), f)) {
+    Box b;
+    if (sscanf(line, "%d,%d,%d,%d", &b.x0, &b.y0, &b.x1, &b.y1) != 4)
+      continue;
+    if (opts.flip_rectangle_y_coordinates) {
+      int t = b.y0;
+      b.y0 = h - 1 - b.y1;
+      b.y1 = h - 1 - t;
+    }
+    rects.push_back(b);
+  }
+  fclose(f);
+
+  logver("read %u rectangles from '%s'", rects.size(), fn);
+  return true;
+}
+
+// A region is the same as before if no point of its bounding box
+// or the border around it has changed. Then the old mask had this
+// very component, since every point joined to it lies in there.
+static bool unchanged(const Bitmap &now, const Bitmap &old,
+                      const Region &r) {
+  Point o = r.origin();
+  int x0 = max(o.x - 1, 0), x1 = min(o.x + r.width(), now.width() - 1);
+  int y0 = max(o.y - 1, 0), y1 = min(o.y + r.height(), now.height() - 1);
+  for (int y = y0; y <= y1; ++y) {
+    if (!now.same(old, y, x0, x1))
+      return false;
+  }
+  return true;
+}
+
+// Keeps the covers found by an earlier run for the regions of the
+// mask that have not changed since. Old rectangles are matched to
+// regions by their first point and checked to lie wholly inside
+// them without overlapping; a region with any that do not is covered
+// again. So is one they leave more than -u points of uncovered with
+// fewer than -c rectangles, as a stale or cut short list would, though
+// that also takes the regions whose small rectangles were left out
+// under -a.
+bool keep_previous_covers(Region &mask, const string &old_mask,
+                          const string &old_rects) {
+  Bitmap old;
+  if (!read_image(old_mask, old))
+    return false;
+
+  const Bitmap &now = mask.bitmap();
+  int w = now.width(), h = now.height();
+  if (old.width() != w || old.height() != h) {
+    loginfo("previous mask '%s' is %dx%d instead of %dx%d,"
+            " covering every region", old_mask.c_str(),
+            old.width(), old.height(), w, h);
+    return true;
+  }
+
+  vector<Box> rects;
+  if (!read_rects(old_rects, h, rects))
+    return false;
+
+  RegionList &l = mask.get_regions();
+  vector<Region *> regions(l.begin(), l.end());
+  vector<char> keep(regions.size(), 0);
+  vector<int> owner((size_t)w * h, -1);
+  for (size_t i = 0; i < regions.size(); ++i) {
+    Region *r = regions[i];
+    if (!(keep[i] = unchanged(now, old, *r)))
+      continue;
+    Point o = r->origin();
+    for (int y = 0; y < r->height(); ++y) {
+      const Bitmap &b = r->bitmap();
+      for (int x = 0; (x = b.next_set(x, y)) < r->width(); ++x)
+        owner[(size_t)(o.y + y) * w + o.x + x] = i;
+    }
+  }
+
+  vector<Cover> covers(regions.size());
+  vector<size_t> covered(regions.size(), 0);
+  vector<char> taken((size_t)w * h, 0);
+  for (size_t j = 0; j < rects.size(); ++j) {
+    Box b = rects[j];
+    if (b.x0 < 0 || b.y0 < 0 || b.x0 > b.x1 || b.y0 > b.y1
+        || b.x1 >= w || b.y1 >= h)
+      continue;
+    int i = owner[(size_t)b.y0 * w + b.x0];
+    if (i < 0 || !keep[i])
+      continue;
+
+    Region *r = regions[i];
+    Point o = r->origin();
+    b.x0 -= o.x;
+    b.x1 -= o.x;
+    b.y0 -= o.y;
+    b.y1 -= o.y;
+    bool inside = b.x1 < r->width() && b.y1 < r->height();
+    for (int y = b.y0; inside && y <= b.y1; ++y)
+      inside = r->bitmap().all(y, b.x0, b.x1);
+    for (int y = rects[j].y0; inside && y <= rects[j].y1; ++y) {
+      char *t = &taken[(size_t)y * w];
+      for (int x = rects[j].x0; inside && x <= rects[j].x1; ++x)
+        inside = !t[x];
+    }
+    if (!inside) {
+      logver("previous rectangle %d,%d,%d,%d does not fit its region",
+             rects[j].x0, rects[j].y0, rects[j].x1, rects[j].y1);
+      keep[i] = 0;
+      continue;
+    }
+    for (int y = rects[j].y0; y <= rects[j].y1; ++y)
+      memset(&taken[(size_t)y * w + rects[j].x0], 1, b.width());
+    covers[i].push_back(b);
+    covered[i] += b.area();
+  }
+
+  size_t n = 0;
+  for (size_t i = 0; i < regions.size(); ++i) {
+    if (keep[i] && covers[i].size() < opts.maximum_box_count
+        && regions[i]->count() - covered[i]
+           > opts.maximum_uncovered_points) {
+      logver("previous rectangles leave %u points of a region uncovered",
+             regions[i]->count() - covered[i]);
+      keep[i] = 0;
+    }
+    if (keep[i]) {
+      regions[i]->set_cover(covers[i]);
+      ++n;
+    }
+  }
+  loginfo("kept previous covers of %u of %u regions", n, regions.size());
+  return true;
+}
@@ -22,6 +22,8 @@
 #include "log.hpp"
 #include "random.hpp"
 
+static unsigned rng_seed;
+
 static unsigned time_seed() {
   time_t now = std::time(0);
   unsigned char *p = (unsigned char *)&now;
@@ -35,15 +37,37 @@ void initialize_rng(int sv) {
   if (sv == -1) {
     unsigned s = time_seed();
     logver("RNG seed set to system time hash (%u)", s);
-    std::srand(s);
+    rng_seed = s;
   } else {
     logver("using %d as RNG seed", sv);
-    std::srand(sv);
+    rng_seed = sv;
   }
 }
 
-int random_int(int upper_bound) {
-  double d = std::rand() * (1.0 / (RAND_MAX + 1.0));
+// splitmix64 finalizer
+static uint64_t mix(uint64_t z) {
+  z += 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+Random::Random(uint64_t stream)
+  :m_state(mix(mix(rng_seed) ^ stream)) {
+  if (!m_state)
+    m_state = 0x9e3779b97f4a7c15ULL;
+}
+
+// xorshift64*
+uint64_t Random::next() {
+  m_state ^= m_state >> 12;
+  m_state ^= m_state << 25;
+  m_state ^= m_state >> 27;
+  return m_state * 0x2545f4914f6cdd1dULL;
+}
+
+int Random::next_int(int upper_bound) {
+  double d = (next() >> 11) * (1.0 / 9007199254740992.0);
   int r = d * upper_bound;
   return r;
 }
@@ -19,7 +19,21 @@
 #ifndef MASK2RECTS_RANDOM_HPP
 #define MASK2RECTS_RANDOM_HPP
 
+#include <stdint.h>
+
 void initialize_rng(int seed);
-int random_int(int upper_bound);
+
+// Each stream number gives a separate sequence derived from the seed
+// passed to initialize_rng(), independent of which thread draws it.
+class Random {
+private:
+  uint64_t m_state;
+
+public:
+  Random(uint64_t stream);
+
+  uint64_t next();
+  int next_int(int upper_bound);
+};
 
 #endif // MASK2RECTS_RANDOM_HPP
@@ -17,23 +17,31 @@
 //    along with mask2rects.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <algorithm>
-#include <map>
 
+#include "bitmap.hpp"
 #include "box.hpp"
 #include "image.hpp"
 #include "label.hpp"
 #include "log.hpp"
 #include "options.hpp"
+#include "partition.hpp"
 #include "random.hpp"
 #include "region.hpp"
+#include "thread.hpp"
+#include "timer.hpp"
 
 using namespace std;
 
-typedef map<int, Box> BoxMap;
-typedef map<int, Label *> LabelMap;
+Region::Region()
+  :m_width(0), m_height(0), m_size(0),
+   m_iterations(0), m_uncovered(0), m_cover_time(0), m_trial_time(0),
+   m_reused(false) {
+}
 
 Region::Region(int w, int h)
-  :m_width(w), m_height(h), m_size(w * h), m_data(m_size, 0) {
+  :m_width(w), m_height(h), m_size(w * h), m_data(w, h),
+   m_iterations(0), m_uncovered(0), m_cover_time(0), m_trial_time(0),
+   m_reused(false) {
 }
 
 void Region::clear() {
@@ -44,241 +52,558 @@ void Region::clear() {
   m_origin = Point();
 }
 
-void Region::get_near_values(int x, int y, const vector<int> &values,
-                             vector<int> &results) const {
-  vector<int> positions;
-  if (x > 0)
-    positions.push_back(x - 1 + y * m_width);
-  if (y > 0)
-    positions.push_back(x + (y - 1) * m_width);
-
-  for (unsigned i = 0; i < positions.size(); ++i) {
-    int p = positions[i];
-    if (m_data[p]) {
-      int v = values[p];
-      if (v)
-        results.push_back(v);
-    }
+void Region::get_runs(int y, RunList &results) const {
+  int x = 0;
+  while ((x = m_data.next_set(x, y)) < m_width) {
+    int x0 = x;
+    x = m_data.next_clear(x, y);
+    results.push_back(Run(y, x0, x - 1));
   }
 }
 
 bool Region::read(const string &filename) {
   clear();
-  if (!read_image(filename, m_data, m_width, m_height))
+  if (!read_image(filename, m_data))
     return false;
 
+  m_width = m_data.width();
+  m_height = m_data.height();
   m_size = m_width * m_height;
   logver("region is %dx%d (%d total)", m_width, m_height, m_size);
   return true;
 }
 
 bool Region::write(const string &filename) {
-  if (!write_image(filename, m_data, m_width, m_height))
+  if (!write_image(filename, m_data))
     return false;
   return true;
 }
 
-// a.k.a connected-component labeling
-void Region::calculate_connected_regions() {
-  logver("calculating connected regions");
-  clear_regions();
-
-  vector<int> values(m_size, 0);
-  LabelMap labels;
-  int next_label_value = 1;
-
-  logver("labeling foreground points");
-  for (int y = 0; y < m_height; ++y) {
-    for (int x = 0; x < m_width; ++x) {
-      int p = x + y * m_width;
-      if (!m_data[p])
-        continue;
-
-      vector<int> near_values;
-      get_near_values(x, y, values, near_values);
-
-      if (near_values.empty()) {
-        int v = next_label_value++;
-        labels[v] = new Label(v);
-        values[p] = v;
-        continue;
-      }
-
-      int v = *min_element(near_values.begin(), near_values.end());
-      Label *l = labels[v];
-      Label *r = l->root();
+// Labels the runs of a region in horizontal strips. Each strip is
+// encoded and joined on its own thread, then the rows on either
+// side of every strip border are joined, again concurrently.
+class Region::LabelJob : public Job {
+public:
+  enum { ENCODE, JOIN, MERGE, RESOLVE, COPY };
+
+  struct Strip {
+    int y0, y1;
+    size_t first, last;
+    RunList runs;
+    vector<int> row_start;
+  };
+
+  Region &region;
+  vector<Strip> strips;
+  RunList runs;
+  vector<int> row_start;
+  vector<int> values;
+  vector<Region *> subs;
+  Labels *labels;
+  int phase;
+
+  LabelJob(Region &r, size_t n);
+  void run(size_t s);
+  void collect();
+  void join_rows(int y);
+};
+
+Region::LabelJob::LabelJob(Region &r, size_t n)
+  :region(r), strips(n), row_start(r.m_height + 1, 0),
+   labels(0), phase(ENCODE) {
+  int h = r.m_height;
+  for (size_t i = 0; i < n; ++i) {
+    strips[i].y0 = h * i / n;
+    strips[i].y1 = h * (i + 1) / n;
+  }
+}
 
-      for (unsigned i = 0; i < near_values.size(); i++) {
-        Label *n = labels[near_values[i]];
-        if (r->value() != n->root()->value()) {
-          n->join(l);
-        }
-      }
-      values[p] = v;
+void Region::LabelJob::run(size_t s) {
+  Strip &t = strips[s];
+  switch (phase) {
+  case ENCODE:
+    for (int y = t.y0; y < t.y1; ++y) {
+      t.row_start.push_back(t.runs.size());
+      region.get_runs(y, t.runs);
     }
+    break;
+  case JOIN:
+    for (int y = t.y0 + 1; y < t.y1; ++y)
+      join_rows(y);
+    break;
+  case MERGE:
+    if (t.y0 > 0)
+      join_rows(t.y0);
+    break;
+  case RESOLVE:
+    for (size_t i = t.first; i < t.last; ++i)
+      values[i] = labels->root(i);
+    break;
+  case COPY:
+    // rows never share bitmap words, and each row is in one strip
+    for (size_t i = t.first; i < t.last; ++i) {
+      const Run &n = runs[i];
+      Region *r = subs[values[i]];
+      Point o = r->m_origin;
+      r->m_data.fill(n.y - o.y, n.x0 - o.x, n.x1 - o.x, true);
+    }
+    break;
   }
+}
 
-  logver("reducing labels");
-  for (int p = 0; p < m_size; ++p) {
-    int v = values[p];
-    if (!v)
-      continue;
-    int m = labels[v]->root()->value();
-    if (m < v)
-      values[p] = m;
+// gather the runs of all strips in row order
+void Region::LabelJob::collect() {
+  size_t n = 0;
+  for (size_t s = 0; s < strips.size(); ++s)
+    n += strips[s].runs.size();
+  runs.reserve(n);
+  for (size_t s = 0; s < strips.size(); ++s) {
+    Strip &t = strips[s];
+    t.first = runs.size();
+    for (int y = t.y0; y < t.y1; ++y)
+      row_start[y] = t.first + t.row_start[y - t.y0];
+    runs.insert(runs.end(), t.runs.begin(), t.runs.end());
+    t.last = runs.size();
+    RunList().swap(t.runs);
   }
+  row_start[region.m_height] = runs.size();
+  values.resize(runs.size(), -1);
+}
 
-  for (LabelMap::iterator i = labels.begin(); i != labels.end(); ++i) {
-    delete i->second;
+void Region::LabelJob::join_rows(int y) {
+  int i = row_start[y - 1], ie = row_start[y];
+  int j = row_start[y], je = row_start[y + 1];
+  while (i < ie && j < je) {
+    if (runs[i].touches(runs[j]))
+      labels->join(i, j);
+    if (runs[i].x1 < runs[j].x1)
+      ++i;
+    else
+      ++j;
   }
+}
 
-  BoxMap boxes;
-  
+// a.k.a connected-component labeling, done on horizontal runs
+// of foreground points rather than on the points themselves
+void Region::calculate_connected_regions() {
+  logver("calculating connected regions");
+  clear_regions();
+
+  size_t n = thread_count();
+  if (n > (size_t)m_height)
+    n = m_height > 0 ? m_height : 1;
+  LabelJob job(*this, n);
+
+  logver("encoding foreground runs in %u strips", n);
+  run_parallel(job, n);
+  job.collect();
+
+  logver("labeling %u runs", job.runs.size());
+  Labels labels(job.runs.size());
+  job.labels = &labels;
+  job.phase = LabelJob::JOIN;
+  run_parallel(job, n);
+  job.phase = LabelJob::MERGE;
+  run_parallel(job, n);
+  job.phase = LabelJob::RESOLVE;
+  run_parallel(job, n);
+
+  // number the regions in order of their first point
   logver("finding bounding boxes");
-  for (int y = 0; y < m_height; ++y) {
-    for (int x = 0; x < m_width; ++x) {
-      int p = x + y * m_width;
-      int v = values[p];
-      if (!v)
-        continue;
-
-      BoxMap::iterator i = boxes.find(v);
-      if (i == boxes.end()) {
-        boxes[v] = Box(x, y);
-      } else {
-        Box &b = i->second;
-        b.add(x, y);
-      }
+  RunList &runs = job.runs;
+  vector<int> &values = job.values;
+  vector<int> ids(runs.size(), -1);
+  vector<Box> boxes;
+  for (size_t i = 0; i < runs.size(); ++i) {
+    const Run &r = runs[i];
+    int l = values[i];
+    if (ids[l] < 0) {
+      ids[l] = boxes.size();
+      boxes.push_back(Box(r.x0, r.y));
     }
+    int v = ids[l];
+    boxes[v].add(r.x0, r.y);
+    boxes[v].add(r.x1, r.y);
+    values[i] = v;
   }
 
   logver("copying connected sub-regions");
-  for (BoxMap::iterator i = boxes.begin(); i != boxes.end(); ++i) {
-    int v = i->first;
-    Box &b = i->second;
+  for (size_t v = 0; v < boxes.size(); ++v) {
+    Box &b = boxes[v];
     Region *r = new Region(b.width(), b.height());
     r->m_origin = b.origin();
-    for (int y = 0; y < b.height(); ++y) {
-      for (int x = 0; x < b.width(); ++x) {
-        int p = x + b.x0 + (y + b.y0) * m_width;
-        int o = x + y * b.width();
-        if (values[p] == v)
-          r->m_data[o] = m_data[p];
-      }
-    }
+    job.subs.push_back(r);
     m_regions.push_back(r);
   }
+  job.phase = LabelJob::COPY;
+  run_parallel(job, n);
 
   logver("found %u connected regions", m_regions.size());
 }
 
-void Region::get_uncovered(const vector<int> &values, vector<Point> &results) {
-  for (int y = 0; y < m_height; ++y) {
-    for (int x = 0; x < m_width; ++x) {
-      int p = x + y * m_width;
-      if (values[p] == 1)
-        results.push_back(Point(x, y));
-    }
-  }
-}
-
-int Region::grow_box(Box &b, const vector<int> &values, int d) {
-  int x0 = b.x0, y0 = b.y0, x1 = b.x1, y1 = b.y1;
-  int s, e, a;
+int Region::grow_box(Box &b, const Bitmap &u, int d) const {
   switch (d) {
   case D_SOUTH:
-    if (y0 < 1)
+    if (b.y0 < 1 || !u.all(b.y0 - 1, b.x0, b.x1))
       return 0;
-    s = x0 + (y0 - 1) * m_width;
-    e = x1 + (y0 - 1) * m_width;
-    a = 1;
     break;
   case D_WEST:
-    if (x0 < 1)
+    if (b.x0 < 1 || !u.all_column(b.x0 - 1, b.y0, b.y1))
       return 0;
-    s = (x0 - 1) + y0 * m_width;
-    e = (x0 - 1) + y1 * m_width;
-    a = m_width;
     break;
   case D_NORTH:
-    if (y1 >= m_height - 1)
+    if (b.y1 >= m_height - 1 || !u.all(b.y1 + 1, b.x0, b.x1))
       return 0;
-    s = x0 + (y1 + 1) * m_width;
-    e = x1 + (y1 + 1) * m_width;
-    a = 1;
     break;
   case D_EAST:
-    if (x1 >= m_width - 1)
+    if (b.x1 >= m_width - 1 || !u.all_column(b.x1 + 1, b.y0, b.y1))
       return 0;
-    s = (x1 + 1) + y0 * m_width;
-    e = (x1 + 1) + y1 * m_width;
-    a = m_width;
     break;
   default:
     return 0;
   }
-
-  for (int i = s; i <= e; i += a) {
-    if (values[i] != 1)
-      return 0;
-  }
   b.expand(d);
   return 1;
 }
 
-void Region::calculate_cover() {
-  logver("calculating cover for %dx%d region", m_width, m_height);
-  m_cover.clear();
-  size_t uncovered_count = m_size;
-
-  for (size_t i = 0; i < opts.maximum_iterations; ++i) {
-    Cover c;
-    size_t r = m_size;
-    vector<int> values(m_data);
-
-    while (c.size() < opts.maximum_box_count) {
-      vector<Point> u;
-      get_uncovered(values, u);
-      r = u.size();
-      if (r <= opts.maximum_uncovered_points)
+// Grows the box one row or column at a time, taking turns between
+// the four directions until none can move.
+void Region::grow_edges(Box &b, const Bitmap &u) const {
+  int can_grow[4] = { 1, 1, 1, 1 }, grew = 0;
+  do {
+    grew = 0;
+    for (int d = 0; d < 4; d++) {
+      if (can_grow[d]) {
+        if (grow_box(b, u, d))
+          grew++;
+        else
+          can_grow[d] = 0;
+      }
+    }
+  } while (grew);
+}
+
+// Counts uncovered points from (x, y) going north or south, up to
+// the given limit.
+int Region::count_uncovered(const Bitmap &u, int x, int y,
+                            int dy, int limit) const {
+  int n = 0;
+  while (n < limit && 0 <= y && y < m_height && u.get(x, y)) {
+    ++n;
+    y += dy;
+  }
+  return n;
+}
+
+// Grows the single point box b into the largest rectangle of
+// uncovered points containing it. Any such rectangle spans the row
+// of b, so it is fixed by its columns: it reaches as far north and
+// south as the shortest of their uncovered runs up and down from
+// that row. Walking out from b, a column is only scanned as far as
+// the shortest run so far, and only the columns where that shortest
+// run drops can end the best rectangle, so just pairs of them are
+// compared.
+void Region::grow_largest(Box &b, const Bitmap &u) const {
+  struct Side { int x, up, down; };
+  const int x = b.x0, y = b.y0;
+  Side s = {
+    x,
+    count_uncovered(u, x, y, 1, m_height),
+    count_uncovered(u, x, y, -1, m_height)
+  };
+
+  vector<Side> west, east;
+  for (int d = -1; d <= 1; d += 2) {
+    vector<Side> &v = d < 0 ? west : east;
+    Side c = s;
+    for (;;) {
+      int n = c.x + d;
+      if (n < 0 || n >= m_width || !u.get(n, y)) {
+        v.push_back(c);
         break;
+      }
+      int up = count_uncovered(u, n, y, 1, c.up);
+      int down = count_uncovered(u, n, y, -1, c.down);
+      if (up < c.up || down < c.down)
+        v.push_back(c);
+      c.x = n;
+      c.up = up;
+      c.down = down;
+    }
+  }
+
+  unsigned best = 0;
+  for (size_t i = 0; i < west.size(); ++i) {
+    for (size_t j = 0; j < east.size(); ++j) {
+      int n = min(west[i].up, east[j].up);
+      int s = min(west[i].down, east[j].down);
+      unsigned a = (east[j].x - west[i].x + 1) * (n + s - 1);
+      if (a > best) {
+        best = a;
+        b.x0 = west[i].x;
+        b.x1 = east[j].x;
+        b.y0 = y - s + 1;
+        b.y1 = y + n - 1;
+      }
+    }
+  }
+}
+
+// Uncovered points per row of a trial, kept as a Fenwick tree so the
+// row holding the k-th uncovered point is found in log time.
+class RowCounts {
+private:
+  vector<size_t> m_tree;
+  int m_top;
+
+public:
+  RowCounts(const Bitmap &b)
+    :m_tree(b.height() + 1, 0), m_top(1) {
+    int h = b.height();
+    while (m_top * 2 <= h)
+      m_top *= 2;
+    for (int i = 1; i <= h; ++i) {
+      m_tree[i] += b.count(i - 1);
+      int j = i + (i & -i);
+      if (j <= h)
+        m_tree[j] += m_tree[i];
+    }
+  }
+
+  void remove(int y, size_t n) {
+    for (int i = y + 1; i < (int)m_tree.size(); i += i & -i)
+      m_tree[i] -= n;
+  }
 
-      Point p = u[random_int(r)];
-      Box b(p);
-      int can_grow[4] = { 1, 1, 1, 1 }, grew = 0;
-      do {
-        grew = 0;
-        for (int d = 0; d < 4; d++) {
-          if (can_grow[d]) {
-            if (grow_box(b, values, d))
-              grew++;
-            else
-              can_grow[d] = 0;
-          }
-        }
-      } while (grew);
-        
-      for (int y = b.y0; y <= b.y1; ++y) {
-        for (int x = b.x0; x <= b.x1; ++x) {
-          int p = x + y * m_width;
-          values[p] = 2;
-          r--;
-        }
+  // the row of the k-th point, leaving k its place in that row
+  int find(size_t &k) const {
+    int i = 0;
+    for (int s = m_top; s; s >>= 1) {
+      if (i + s < (int)m_tree.size() && m_tree[i + s] <= k) {
+        i += s;
+        k -= m_tree[i];
       }
+    }
+    return i;
+  }
+};
+
+// One randomized trial: boxes are grown from random uncovered
+// points until the limits are met. Returns the points left uncovered.
+// Besides the bitmap of uncovered points a trial only keeps a count
+// per row, to pick seeds by rank. Boxes only ever grow over uncovered
+// points, so each takes its area off the counts.
+size_t Region::find_cover(Random &rng, size_t points, Cover &c) const {
+  Bitmap u(m_data);
+  RowCounts rows(u);
+  size_t left = points;
+
+  while (c.size() < opts.maximum_box_count) {
+    if (left <= opts.maximum_uncovered_points)
+      break;
+
+    size_t k = rng.next_int(left);
+    int y = rows.find(k);
+    Box b(u.select(y, k), y);
+    if (opts.growth == GROW_HISTOGRAM)
+      grow_largest(b, u);
+    else
+      grow_edges(b, u);
+
+    for (int y = b.y0; y <= b.y1; ++y) {
+      u.fill(y, b.x0, b.x1, false);
+      rows.remove(y, b.width());
+    }
+    left -= b.area();
+
+    if (b.area() >= opts.minimum_box_area)
+      c.push_back(b);
+  }
+  return left;
+}
+
+// Runs the trials of a cover search concurrently. Ties between
+// equally good covers go to the lowest numbered trial, so the
+// result does not depend on which trials finish first. Once a
+// complete cover is as small as any partition can be, the trials
+// numbered after it are skipped, since none of them could win.
+class Region::CoverJob : public Job {
+public:
+  Region &region;
+  size_t points, bound;
+  uint64_t stream;
+  size_t first;
+  Mutex mutex;
+  bool found;
+  size_t best, uncovered, runs;
+  double seconds;
+
+  CoverJob(Region &r, size_t p, size_t b, unsigned s)
+    :region(r), points(p), bound(b), stream(s), first(0), mutex(),
+     found(false), best(0), uncovered(0), runs(0), seconds(0) {}
+  bool optimal() const {
+    return found && !uncovered && region.m_cover.size() <= bound;
+  }
+  void run(size_t i);
+};
+
+void Region::CoverJob::run(size_t part) {
+  size_t i = first + part;
+  {
+    Lock l(mutex);
+    if (optimal() && best < i)
+      return;
+  }
+  Timer t;
+  t.start();
+  Random rng(stream << 32 | i);
+  Cover c;
+  size_t r = region.find_cover(rng, points, c);
+  t.stop();
+  logver("iteration %u: cover found has %u rectangles"
+         " (%u uncovered points)", i, c.size(), r);
+
+  Lock l(mutex);
+  seconds += t.value();
+  ++runs;
+  Cover &m = region.m_cover;
+  if (!found || c.size() < m.size()
+      || (c.size() == m.size() && r < uncovered)
+      || (c.size() == m.size() && r == uncovered && i < best)) {
+    m.swap(c);
+    uncovered = r;
+    best = i;
+    found = true;
+  }
+}
 
-      if (b.area() >= opts.minimum_box_area)
-        c.push_back(b);
+// A lower bound on the number of rectangles in any partition of the
+// region. A partition needs R - L - H + 1 rectangles, R being the
+// reflex corners, H the holes and L the most chords that can be cut
+// between reflex corners without crossing, and L is at most R / 2.
+// The corners are counted from the 2x2 windows of the bitmap, and
+// the holes from its Euler number. Where the outline touches itself
+// at a diagonal pinch, the two corners can be pulled apart without
+// changing which sets of points are rectangles. They are then convex,
+// and the holes become the 8-connected background components the
+// Euler number of a 4-connected region counts, so the bound holds.
+size_t Region::partition_bound() const {
+  int q1 = 0, q3 = 0, qd = 0;
+  for (int y = 0; y <= m_height; ++y) {
+    for (int x = 0; x <= m_width; ++x) {
+      bool a = x > 0 && y > 0 && m_data.get(x - 1, y - 1);
+      bool b = x < m_width && y > 0 && m_data.get(x, y - 1);
+      bool c = x > 0 && y < m_height && m_data.get(x - 1, y);
+      bool d = x < m_width && y < m_height && m_data.get(x, y);
+      switch (a + b + c + d) {
+      case 1: ++q1; break;
+      case 2: qd += a == d; break;
+      case 3: ++q3; break;
+      }
     }
-    logver("iteration %u: cover found has %u rectangles"
-           " (%u uncovered points)", i, c.size(), r);
-    if (m_cover.empty() || c.size() < m_cover.size()
-        || (c.size() == m_cover.size() && r < uncovered_count)) {
-      m_cover = c;
-      uncovered_count = r;
+  }
+  // the region is a single 4-connected component, so 1 - holes
+  int euler = (q1 - q3 + 2 * qd) / 4;
+  int bound = (q3 + 1) / 2 + euler;
+  return bound > 1 ? bound : 1;
+}
+
+static bool larger_box(const Box *a, const Box *b) {
+  return a->area() > b->area();
+}
+
+// The minimum partition is cut down to the same limits the random
+// search works to: at most -c rectangles, keeping the largest, and
+// then the smallest left out for as long as -u permits.
+void Region::calculate_exact_cover() {
+  logver("calculating exact cover for %dx%d region", m_width, m_height);
+  m_cover.clear();
+
+  Cover c;
+  find_partition(*this, c);
+
+  vector<const Box *> order;
+  for (Cover::iterator i = c.begin(); i != c.end(); ++i)
+    order.push_back(&*i);
+  stable_sort(order.begin(), order.end(), larger_box);
+
+  size_t keep = min(order.size(), opts.maximum_box_count);
+  size_t r = 0;
+  for (size_t i = keep; i < order.size(); ++i)
+    r += order[i]->area();
+  while (keep > 0
+         && r + order[keep - 1]->area() <= opts.maximum_uncovered_points)
+    r += order[--keep]->area();
+
+  order.resize(keep);
+  sort(order.begin(), order.end());
+  for (Cover::iterator i = c.begin(); i != c.end(); ++i) {
+    if (i->area() >= opts.minimum_box_area
+        && binary_search(order.begin(), order.end(), &*i))
+      m_cover.push_back(*i);
+  }
+
+  m_iterations = 1;
+  m_uncovered = r;
+  logver("exact cover has %u rectangles and %u uncovered points",
+         m_cover.size(), r);
+}
+
+// All -i trials are run at once. With a budget of trial seconds
+// instead, they are run a batch at a time until it is spent, since
+// the time taken is only known once a batch is done. Later batches
+// only hold higher numbered trials, which never win a tie.
+void Region::calculate_cover(unsigned stream, double budget) {
+  Timer t;
+  t.start();
+  if (opts.exact_cover) {
+    calculate_exact_cover();
+    t.stop();
+    m_cover_time = m_trial_time = t.value();
+    return;
+  }
+
+  logver("calculating cover for %dx%d region", m_width, m_height);
+  m_cover.clear();
+
+  size_t points = count();
+
+  size_t bound = 0;
+  if (!opts.maximum_uncovered_points && opts.minimum_box_area <= 1)
+    bound = partition_bound();
+
+  CoverJob job(*this, points, bound, stream);
+  if (budget <= 0) {
+    run_parallel(job, opts.maximum_iterations);
+  } else {
+    size_t batch = thread_count();
+    while (!job.optimal() && job.seconds < budget) {
+      run_parallel(job, batch);
+      job.first += batch;
     }
   }
+  if (job.optimal())
+    logver("cover of %u rectangles is optimal", m_cover.size());
+  t.stop();
+  m_iterations = job.runs;
+  m_uncovered = job.uncovered;
+  m_cover_time = t.value();
+  m_trial_time = job.seconds;
+
   logver("final cover has %u rectangles and %u uncovered points",
-         m_cover.size(), uncovered_count);
+         m_cover.size(), job.uncovered);
+}
+
+// Takes a cover found before, such as by an earlier run.
+void Region::set_cover(const Cover &c) {
+  m_cover = c;
+  size_t covered = 0;
+  for (Cover::const_iterator i = c.begin(); i != c.end(); ++i)
+    covered += i->area();
+  m_iterations = 0;
+  m_uncovered = count() - covered;
+  m_cover_time = m_trial_time = 0;
+  m_reused = true;
 }
 
 void Region::clear_regions() {
@@ -23,38 +23,54 @@
 #include <string>
 #include <vector>
 
+#include "bitmap.hpp"
 #include "box.hpp"
 #include "point.hpp"
+#include "run.hpp"
 
 typedef std::list<Box> Cover;
 
+class Random;
+
 class Region;
 typedef std::list<Region *> RegionList;
 
 class Region {
 private:
   int m_width, m_height, m_size;
-  std::vector<int> m_data;
+  Bitmap m_data;
   Point m_origin;
   RegionList m_regions;
   Cover m_cover;
+  size_t m_iterations, m_uncovered;
+  double m_cover_time, m_trial_time;
+  bool m_reused;
 
-  void get_near_values(int x, int y, const std::vector<int> &values,
-                       std::vector<int> &results) const; 
-  void get_uncovered(const std::vector<int> &values,
-                     std::vector<Point> &results);
-  int grow_box(Box &b, const std::vector<int> &values, int d);
+  class LabelJob;
+  class CoverJob;
+  void get_runs(int y, RunList &results) const;
+  int grow_box(Box &b, const Bitmap &u, int d) const;
+  void grow_edges(Box &b, const Bitmap &u) const;
+  int count_uncovered(const Bitmap &u, int x, int y,
+                      int dy, int limit) const;
+  void grow_largest(Box &b, const Bitmap &u) const;
+  size_t find_cover(Random &rng, size_t points, Cover &c) const;
+  size_t partition_bound() const;
+  void calculate_exact_cover();
   void clear_regions();
 
 public:
-  Region() {}
+  Region();
   Region(int w, int h);
   ~Region();
 
   int width() const { return m_width; }
   int height() const { return m_height; }
+  int size() const { return m_size; }
   Point origin() const { return m_origin; }
-  int get(int x, int y) const { return m_data[x + y * m_width]; }
+  int get(int x, int y) const { return m_data.get(x, y); }
+  size_t count() const { return m_data.count(); }
+  const Bitmap &bitmap() const { return m_data; }
   void clear();
   bool read(const std::string &filename);
   bool write(const std::string &filename);
@@ -62,8 +78,16 @@ public:
   void calculate_connected_regions();
   RegionList& get_regions() { return m_regions; }
 
-  void calculate_cover();
+  void calculate_cover(unsigned stream, double budget = 0);
   Cover& get_cover() { return m_cover; }
+  void set_cover(const Cover &c);
+
+  // statistics of the last cover calculated
+  size_t iterations() const { return m_iterations; }
+  size_t uncovered() const { return m_uncovered; }
+  double cover_time() const { return m_cover_time; }
+  double trial_time() const { return m_trial_time; }
+  bool reused() const { return m_reused; }
 };
 
 #endif // MASK2RECTS_REGION_HPP
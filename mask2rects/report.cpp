@@ -0,0 +1,146 @@
+//
+// Copyright 2013 Cole Minor <c.minor@inbox.com>
+//
+//    This file is part of mask2rects.
+//
+//    mask2rects is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    mask2rects is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with mask2rects.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <string>
+#include <vector>
+
+#include "options.hpp"
+#include "region.hpp"
+#include "report.hpp"
+#include "thread.hpp"
+
+using namespace std;
+
+static void write_string(FILE *f, const string &s) {
+  fputc('"', f);
+  for (size_t i = 0; i < s.size(); ++i) {
+    unsigned char c = s[i];
+    if (c == '"' || c == '\\')
+      fprintf(f, "\\%c", c);
+    else if (c < 0x20)
+      fprintf(f, "\\u%04x", c);
+    else
+      fputc(c, f);
+  }
+  fputc('"', f);
+}
+
+// Box areas are counted in bins of powers of two, [1,1], [2,3],
+// [4,7] and so on.
+static void write_histogram(FILE *f, const Cover &cover) {
+  vector<size_t> bins;
+  for (Cover::const_iterator b = cover.begin(); b != cover.end(); ++b) {
+    size_t i = 0;
+    for (unsigned a = b->area(); a > 1; a >>= 1)
+      ++i;
+    if (bins.size() <= i)
+      bins.resize(i + 1, 0);
+    ++bins[i];
+  }
+
+  fprintf(f, "[");
+  const char *sep = "";
+  for (size_t i = 0; i < bins.size(); ++i) {
+    if (!bins[i])
+      continue;
+    unsigned long lo = 1UL << i;
+    fprintf(f, "%s{\"min\": %lu, \"max\": %lu, \"count\": %lu}",
+            sep, lo, 2 * lo - 1, (unsigned long)bins[i]);
+    sep = ", ";
+  }
+  fprintf(f, "]");
+}
+
+static void write_mask(FILE *f, const MaskSpec &m, Region &r) {
+  RegionList &regions = r.get_regions();
+  int h = r.height();
+
+  size_t rects = 0, uncovered = 0;
+  for (RegionList::iterator i = regions.begin(); i != regions.end(); ++i) {
+    rects += (*i)->get_cover().size();
+    uncovered += (*i)->uncovered();
+  }
+
+  fprintf(f, "    {\"image\": ");
+  write_string(f, m.file);
+  fprintf(f, ", \"section\": ");
+  write_string(f, m.section);
+  fprintf(f, ",\n     \"width\": %d, \"height\": %d, \"regions\": %lu, "
+          "\"rectangles\": %lu, \"uncovered\": %lu,\n",
+          r.width(), h, (unsigned long)regions.size(),
+          (unsigned long)rects, (unsigned long)uncovered);
+
+  fprintf(f, "     \"covers\": [");
+  size_t n = 0;
+  for (RegionList::iterator i = regions.begin(); i != regions.end(); ++i) {
+    Region *s = *i;
+    Point o = s->origin();
+    int y0 = o.y, y1 = o.y + s->height() - 1;
+    if (opts.flip_rectangle_y_coordinates) {
+      int t = y0;
+      y0 = h - 1 - y1;
+      y1 = h - 1 - t;
+    }
+    size_t k = s->iterations();
+
+    fprintf(f, "%s\n      {\"region\": %lu, \"bounds\": [%d, %d, %d, %d], "
+            "\"area\": %lu,\n", n ? "," : "", (unsigned long)n,
+            o.x, y0, o.x + s->width() - 1, y1, (unsigned long)s->count());
+    fprintf(f, "       \"iterations\": %lu, \"seconds\": %.6f, "
+            "\"seconds_per_iteration\": %.6f,\n", (unsigned long)k,
+            s->cover_time(), k ? s->trial_time() / k : 0.0);
+    fprintf(f, "       \"rectangles\": %lu, \"uncovered\": %lu, "
+            "\"reused\": %s,\n", (unsigned long)s->get_cover().size(),
+            (unsigned long)s->uncovered(), s->reused() ? "true" : "false");
+    fprintf(f, "       \"box_areas\": ");
+    write_histogram(f, s->get_cover());
+    fprintf(f, "}");
+    ++n;
+  }
+  fprintf(f, "%s]}", n ? "\n     " : "");
+}
+
+// Writes a JSON description of the covers found for the connected
+// regions of each mask, in the same order and coordinates as the
+// rectangle list.
+bool write_report(FILE *f, const vector<Region *> &masks,
+                  const Timings &t) {
+  fprintf(f, "{\n  \"options\": {\"exact\": %s, \"growth\": \"%s\", "
+          "\"iterations\": %lu, \"rectangles\": %lu, "
+          "\"uncovered\": %lu, \"minimum_area\": %lu, \"threads\": %lu, "
+          "\"time_budget\": %.6f},\n",
+          opts.exact_cover ? "true" : "false",
+          opts.growth == GROW_HISTOGRAM ? "histogram" : "edges",
+          (unsigned long)opts.maximum_iterations,
+          (unsigned long)opts.maximum_box_count,
+          (unsigned long)opts.maximum_uncovered_points,
+          (unsigned long)opts.minimum_box_area,
+          (unsigned long)thread_count(), opts.time_budget);
+  fprintf(f, "  \"seconds\": {\"read\": %.6f, \"labelling\": %.6f, "
+          "\"cover\": %.6f, \"output\": %.6f},\n",
+          t.read, t.label, t.cover, t.output);
+
+  fprintf(f, "  \"masks\": [\n");
+  for (size_t i = 0; i < masks.size(); ++i) {
+    write_mask(f, opts.masks[i], *masks[i]);
+    fprintf(f, "%s\n", i + 1 < masks.size() ? "," : "");
+  }
+  fprintf(f, "  ]\n}\n");
+
+  return !ferror(f);
+}
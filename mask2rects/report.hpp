@@ -0,0 +1,36 @@
+//
+// Copyright 2013 Cole Minor <c.minor@inbox.com>
+//
+//    This file is part of mask2rects.
+//
+//    mask2rects is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    mask2rects is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with mask2rects.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef MASK2RECTS_REPORT_HPP
+#define MASK2RECTS_REPORT_HPP
+
+#include <cstdio>
+#include <vector>
+
+class Region;
+
+// Seconds spent in each stage of a run.
+struct Timings {
+  double read, label, cover, output;
+  Timings():read(0), label(0), cover(0), output(0) {}
+};
+
+bool write_report(FILE *f, const std::vector<Region *> &masks,
+                  const Timings &t);
+
+#endif // MASK2RECTS_REPORT_HPP
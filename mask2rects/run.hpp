@@ -0,0 +1,36 @@
+//
+// Copyright 2013 Cole Minor <c.minor@inbox.com>
+//
+//    This file is part of mask2rects.
+//
+//    mask2rects is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    mask2rects is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with mask2rects.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef MASK2RECTS_RUN_HPP
+#define MASK2RECTS_RUN_HPP
+
+#include <vector>
+
+// A horizontal span of foreground points x0..x1 (inclusive) on row y.
+struct Run {
+  int y, x0, x1;
+  Run():y(0), x0(0), x1(0) {}
+  Run(int y, int x0, int x1):y(y), x0(x0), x1(x1) {}
+
+  int length() const { return x1 - x0 + 1; }
+  bool touches(const Run &o) const { return x0 <= o.x1 && o.x0 <= x1; }
+};
+
+typedef std::vector<Run> RunList;
+
+#endif // MASK2RECTS_RUN_HPP
@@ -0,0 +1,222 @@
+//
+// Copyright 2013 Cole Minor <c.minor@inbox.com>
+//
+//    This file is part of mask2rects.
+//
+//    mask2rects is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    mask2rects is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with mask2rects.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <deque>
+#include <pthread.h>
+#include <unistd.h>
+#include <vector>
+
+#include "log.hpp"
+#include "options.hpp"
+#include "thread.hpp"
+
+using namespace std;
+
+namespace {
+
+struct Group {
+  size_t pending;
+};
+
+struct Task {
+  Job *job;
+  size_t part;
+  Group *group;
+};
+
+struct Queue {
+  Mutex mutex;
+  deque<Task> tasks;
+};
+
+// A work-stealing pool. Every worker owns a queue and takes the
+// newest task from it; when that is empty it steals the oldest task
+// from another queue. A thread waiting for its own tasks to finish
+// keeps working meanwhile, so jobs may be nested freely.
+class Scheduler {
+private:
+  vector<Queue *> m_queues;
+  Mutex m_mutex;
+  pthread_cond_t m_cond;
+  unsigned m_events;
+
+  bool take(size_t self, Task &t);
+  void execute(const Task &t);
+  unsigned events();
+  void notify();
+  void wait(unsigned seen);
+
+public:
+  Scheduler(size_t workers);
+
+  size_t size() const { return m_queues.size(); }
+  void run(Job &job, size_t parts);
+  void work(size_t self, Group *g);
+};
+
+}
+
+static __thread size_t worker_index = 0;
+static Scheduler *scheduler = 0;
+static pthread_once_t scheduler_once = PTHREAD_ONCE_INIT;
+
+struct Start {
+  Scheduler *scheduler;
+  size_t index;
+};
+
+static void *start_worker(void *a) {
+  Start *s = static_cast<Start *>(a);
+  worker_index = s->index;
+  Scheduler *p = s->scheduler;
+  delete s;
+  p->work(worker_index, 0);
+  return 0;
+}
+
+// All queues exist before any worker starts. Should a thread fail
+// to start, its queue is still emptied by the others stealing.
+Scheduler::Scheduler(size_t n)
+  :m_queues(), m_mutex(), m_events(0) {
+  pthread_cond_init(&m_cond, 0);
+  for (size_t i = 0; i < n; ++i)
+    m_queues.push_back(new Queue);
+  size_t started = 0;
+  for (size_t i = 1; i < n; ++i) {
+    Start *s = new Start;
+    s->scheduler = this;
+    s->index = i;
+    pthread_t t;
+    if (pthread_create(&t, 0, start_worker, s)) {
+      logerr("failed to start worker thread %u", i);
+      delete s;
+      continue;
+    }
+    pthread_detach(t);
+    ++started;
+  }
+  logver("started %u worker threads", started);
+}
+
+bool Scheduler::take(size_t self, Task &t) {
+  size_t n = m_queues.size();
+  Queue *q = m_queues[self];
+  {
+    Lock l(q->mutex);
+    if (!q->tasks.empty()) {
+      t = q->tasks.back();
+      q->tasks.pop_back();
+      return true;
+    }
+  }
+  for (size_t k = 1; k < n; ++k) {
+    q = m_queues[(self + k) % n];
+    Lock l(q->mutex);
+    if (!q->tasks.empty()) {
+      t = q->tasks.front();
+      q->tasks.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+void Scheduler::execute(const Task &t) {
+  t.job->run(t.part);
+  if (__sync_sub_and_fetch(&t.group->pending, 1) == 0)
+    notify();
+}
+
+unsigned Scheduler::events() {
+  Lock l(m_mutex);
+  return m_events;
+}
+
+void Scheduler::notify() {
+  Lock l(m_mutex);
+  ++m_events;
+  pthread_cond_broadcast(&m_cond);
+}
+
+void Scheduler::wait(unsigned seen) {
+  Lock l(m_mutex);
+  while (m_events == seen)
+    m_mutex.wait(m_cond);
+}
+
+// The parts are dealt out over all queues, part 0 to the caller's
+// own, and pushed last part first so each owner takes its share in
+// part order.
+void Scheduler::run(Job &job, size_t parts) {
+  size_t self = worker_index;
+  size_t n = m_queues.size();
+  Group g;
+  g.pending = parts;
+  for (size_t i = parts; i-- > 0; ) {
+    Task t;
+    t.job = &job;
+    t.part = i;
+    t.group = &g;
+    Queue *q = m_queues[(self + i) % n];
+    Lock l(q->mutex);
+    q->tasks.push_back(t);
+  }
+  notify();
+  work(self, &g);
+}
+
+// Takes tasks until the group is done, or forever without one.
+// The event count is read before checking for anything to do, so
+// a push or completion after that check cannot be slept through.
+void Scheduler::work(size_t self, Group *g) {
+  for (;;) {
+    unsigned seen = events();
+    if (g && !__sync_fetch_and_add(&g->pending, 0))
+      return;
+    Task t;
+    if (take(self, t))
+      execute(t);
+    else
+      wait(seen);
+  }
+}
+
+static void create_scheduler() {
+  scheduler = new Scheduler(thread_count());
+}
+
+size_t thread_count() {
+  if (opts.thread_count)
+    return opts.thread_count;
+  long n = sysconf(_SC_NPROCESSORS_ONLN);
+  return n > 0 ? n : 1;
+}
+
+// The calling thread works on the job too, and may itself be one
+// of the workers running an outer job.
+void run_parallel(Job &job, size_t parts) {
+  if (parts > 1 && thread_count() > 1) {
+    pthread_once(&scheduler_once, create_scheduler);
+    if (scheduler->size() > 1) {
+      scheduler->run(job, parts);
+      return;
+    }
+  }
+  for (size_t i = 0; i < parts; ++i)
+    job.run(i);
+}
@@ -0,0 +1,62 @@
+//
+// Copyright 2013 Cole Minor <c.minor@inbox.com>
+//
+//    This file is part of mask2rects.
+//
+//    mask2rects is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    mask2rects is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with mask2rects.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef MASK2RECTS_THREAD_HPP
+#define MASK2RECTS_THREAD_HPP
+
+#include <cstddef>
+#include <pthread.h>
+
+// A piece of work split into numbered parts that may run concurrently.
+class Job {
+public:
+  virtual ~Job() {}
+  virtual void run(size_t part) = 0;
+};
+
+class Mutex {
+private:
+  pthread_mutex_t m_mutex;
+  Mutex(const Mutex &);
+  void operator=(const Mutex &);
+
+public:
+  Mutex() { pthread_mutex_init(&m_mutex, 0); }
+  ~Mutex() { pthread_mutex_destroy(&m_mutex); }
+
+  void lock() { pthread_mutex_lock(&m_mutex); }
+  void unlock() { pthread_mutex_unlock(&m_mutex); }
+  void wait(pthread_cond_t &c) { pthread_cond_wait(&c, &m_mutex); }
+};
+
+// Holds a mutex locked for the lifetime of the scope.
+class Lock {
+private:
+  Mutex &m_mutex;
+  Lock(const Lock &);
+  void operator=(const Lock &);
+
+public:
+  Lock(Mutex &m):m_mutex(m) { m_mutex.lock(); }
+  ~Lock() { m_mutex.unlock(); }
+};
+
+size_t thread_count();
+void run_parallel(Job &job, size_t parts);
+
+#endif // MASK2RECTS_THREAD_HPP
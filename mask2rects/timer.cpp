@@ -0,0 +1,37 @@
+//
+// Copyright 2013 Cole Minor <c.minor@inbox.com>
+//
+//    This file is part of mask2rects.
+//
+//    mask2rects is free software: you can redistribute it and/or modify
+//    it under the terms of the GNU General Public License as published by
+//    the Free Software Foundation, either version 3 of the License, or
+//    (at your option) any later version.
+//
+//    mask2rects is distributed in the hope that it will be useful,
+//    but WITHOUT ANY WARRANTY; without even the implied warranty of
+//    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+//    GNU General Public License for more details.
+//
+//    You should have received a copy of the GNU General Public License
+//    along with mask2rects.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <sys/time.h>
+
+#include "timer.hpp"
+
+Timer::Timer()
+  :m_seconds(0) {
+}
+
+void Timer::start() {
+  struct timeval t;
+  gettimeofday(&t, 0);
+  m_seconds = t.tv_sec + 0.000001 * t.tv_usec;
+}
+
+void Timer::stop() {
+  struct timeval t;
+  gettimeofday(&t, 0);
+  m_seconds = t.tv_sec + 0.000001 * t.tv_usec - m_seconds;
+}